@@ -0,0 +1,18 @@
+# Lists every generated kernel variant with the size and hash of its machine code.
+# cmake -DDIR=build/mcode -P cmake/manifest.cmake
+# Reads variants.tsv, written at configure time, and writes manifest.tsv next to it.
+
+file(STRINGS ${DIR}/variants.tsv variants)
+set(manifest "# kernel\tentry\tisa\trequires\tbits\tbytes\tsha256\tfile\n")
+foreach(variant ${variants})
+  string(REPLACE "\t" ";" fields "${variant}")
+  list(GET fields 0 name)
+  list(GET fields 2 isa)
+  foreach(bits 32 64)
+    set(file ${name}.${isa}.x${bits}.bin)
+    file(SIZE ${DIR}/${file} bytes)
+    file(SHA256 ${DIR}/${file} hash)
+    string(APPEND manifest "${variant}\t${bits}\t${bytes}\t${hash}\t${file}\n")
+  endforeach()
+endforeach()
+file(WRITE ${DIR}/manifest.tsv "${manifest}")
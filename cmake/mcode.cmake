@@ -0,0 +1,63 @@
+# Compiles one kernel in source/ to position independent machine code with its entry point at offset 0.
+# cmake -DCC=gcc -DLD=ld -DOBJCOPY=objcopy -DOBJDUMP=objdump -DNM=nm -DSOURCE=source/kernel.c -DENTRY=kernel
+#       -DBITS=64 [-DFLAGS="-mavx2"] -DOUTPUT=kernel.bin -P cmake/mcode.cmake
+# 64-bit code uses the Windows calling convention. 32-bit code expects a 4 byte aligned stack.
+# Code, constants, and data are linked into one section, so the blob runs from any address as long as
+# nothing needs relocating. Absolute relocations are rejected instead of being silently resolved to 0.
+
+set(common -O3 -ffreestanding -fno-builtin -nostdlib -fno-asynchronous-unwind-tables -fno-stack-protector
+    -fno-tree-loop-distribute-patterns -fno-jump-tables -ffunction-sections -fdata-sections -fvisibility=hidden
+    -fno-exceptions -fno-plt -D_MM_MALLOC_H_INCLUDED)
+
+if(BITS EQUAL 64)
+  set(arch -m64 -mabi=ms -fPIE -mno-red-zone)
+  set(emulation elf_x86_64)
+  set(absolute "R_X86_64_(64|32|32S|GOTPCREL[A-Z]*) ")
+else()
+  set(arch -m32 -msse2 -fPIC -mstackrealign -mincoming-stack-boundary=2)
+  set(emulation elf_i386)
+  set(absolute "R_386_(32|GOT32X?) ")
+endif()
+
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+get_filename_component(dir ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${dir})
+set(object ${OUTPUT}.o)
+set(image ${OUTPUT}.elf)
+set(script ${OUTPUT}.ld)
+
+function(run)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE out ERROR_VARIABLE err)
+  if(result)
+    string(REPLACE ";" " " command "${ARGN}")
+    message(FATAL_ERROR "${command}\n${out}${err}")
+  endif()
+  set(out "${out}" PARENT_SCOPE)
+endfunction()
+
+run(${CC} ${common} ${arch} ${flags} -c ${SOURCE} -o ${object})
+
+run(${OBJDUMP} -r ${object})
+string(REGEX MATCHALL "[^\n]*${absolute}[^\n]*" relocations "${out}")
+if(relocations)
+  string(REPLACE ";" "\n" relocations "${relocations}")
+  message(FATAL_ERROR "${SOURCE} (${BITS}-bit) needs absolute relocations and cannot be embedded:\n${relocations}")
+endif()
+
+# The entry point goes first, then everything else it calls or reads.
+file(WRITE ${script} "
+SECTIONS {
+  . = 0;
+  .text : { *(.text.${ENTRY}) *(.text .text.*) *(.rodata .rodata.* .data .data.* .bss .bss.* COMMON) *(.got.plt) *(.got) }
+  /DISCARD/ : { *(.comment) *(.note*) *(.eh_frame*) }
+}
+")
+run(${LD} -m ${emulation} -T ${script} -e ${ENTRY} --no-dynamic-linker -static -o ${image} ${object})
+
+run(${NM} ${image})
+if(NOT out MATCHES "(^|\n)0+ [A-Za-z] ${ENTRY}\n")
+  message(FATAL_ERROR "${ENTRY} is not at offset 0 of ${SOURCE} (${BITS}-bit).")
+endif()
+
+run(${OBJCOPY} -O binary -j .text ${image} ${OUTPUT})
+file(REMOVE ${object} ${image} ${script})
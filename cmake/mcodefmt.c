@@ -0,0 +1,62 @@
+// Formats 32 and 64-bit machine code as the base64 string literals that ImagePut.ahk embeds,
+// 100 characters per line, so that a regenerated kernel can be pasted over the old one.
+// Usage: mcodefmt <32-bit.bin> <64-bit.bin> <output.ahk>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static char * encode(const char * path) {
+    FILE * f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char * bin = malloc(size + 2);
+    if (fread(bin, 1, size, f) != (size_t) size) {
+        perror(path);
+        exit(1);
+    }
+    fclose(f);
+
+    char * str = malloc((size + 2) / 3 * 4 + 1), * p = str;
+    for (long i = 0; i < size; i += 3) {
+        unsigned int n = bin[i] << 16 | (i + 1 < size ? bin[i + 1] << 8 : 0) | (i + 2 < size ? bin[i + 2] : 0);
+        *p++ = alphabet[n >> 18 & 63];
+        *p++ = alphabet[n >> 12 & 63];
+        *p++ = (i + 1 < size) ? alphabet[n >> 6 & 63] : '=';
+        *p++ = (i + 2 < size) ? alphabet[n & 63] : '=';
+    }
+    *p = 0;
+    free(bin);
+    return str;
+}
+
+// Writes the ? (32-bit) or : (64-bit) branch of (A_PtrSize == 4) ? "..." : "..."), closing the parenthesis after the last.
+static void lines(FILE * out, char branch, const char * str, const char * close) {
+    size_t length = strlen(str);
+    for (size_t i = 0; i < length; i += 100)
+        fprintf(out, "            %c \"%.100s\"%s\n", i ? '.' : branch, str + i, (i + 100 >= length) ? close : "");
+}
+
+int main(int argc, char ** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: mcodefmt <32-bit.bin> <64-bit.bin> <output.ahk>\n");
+        return 1;
+    }
+    FILE * out = fopen(argv[3], "w");
+    if (!out) {
+        perror(argv[3]);
+        return 1;
+    }
+    char * b32 = encode(argv[1]), * b64 = encode(argv[2]);
+    lines(out, '?', b32, "");
+    lines(out, ':', b64, ")");
+    fclose(out);
+    free(b32), free(b64);
+    return 0;
+}
@@ -0,0 +1,254 @@
+// Base64 encoder and decoder for UTF-16 strings. Replaces CryptBinaryToString and CryptStringToBinary.
+// The encoder reshuffles 3 bytes into 4 sextets with multiplies and maps them to characters with pshufb.
+// The decoder classifies each character with range compares, so invalid characters are always rejected,
+// and packs 4 sextets back into 3 bytes with pmaddubsw and pmaddwd. AVX2 is used when the OS supports it.
+// url = 1 selects the URL and filename safe alphabet, which uses - and _ in place of + and /.
+#include <cpuid.h>
+#include <immintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+typedef __PTRDIFF_TYPE__ ptrdiff_t;
+
+// The ABI is a target option, so target() would reset -mabi=ms on these functions but not on their callers.
+#ifdef __x86_64__
+#define TARGET(isa) __attribute__((target(isa), ms_abi))
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// 0 = scalar, 1 = SSSE3, 2 = AVX2
+static int level(void) {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3))
+        return 0;
+    if ((c & bit_OSXSAVE) && (c & bit_AVX)) {
+        unsigned int lo, hi;
+        __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        if ((lo & 6) == 6 && __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_AVX2))
+            return 2;
+    }
+    return 1;
+}
+
+static const char alphabet[2][64] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+static int sextet(unsigned short c, int url) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == (url ? '-' : '+')) return 62;
+    if (c == (url ? '_' : '/')) return 63;
+    return -1;
+}
+
+TARGET("ssse3")
+static __m128i encode_ssse3(__m128i in, __m128i shift) {
+    // Copy bytes [b0 b1 b2] to [b1 b0 b2 b1] in each 32-bit lane, then isolate the four sextets.
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    __m128i idx = _mm_or_si128(t0, t1);
+
+    // Reduce each sextet to a range: 0 = [0, 26), 1..11 = [26, 62), 12 = 62, 13 = 63, then add its offset.
+    __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(shift, r));
+}
+
+TARGET("avx2")
+static __m256i encode_avx2(__m256i in, __m256i shift) {
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+    __m256i idx = _mm256_or_si256(t0, t1);
+    __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(idx, _mm256_shuffle_epi8(shift, r));
+}
+
+TARGET("avx2")
+static size_t encode_blocks_avx2(const unsigned char * bin, size_t size, unsigned short * str, int url) {
+    char c62 = url ? '-' : '+', c63 = url ? '_' : '/';
+    __m256i shift = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, c62 - 62, c63 - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, c62 - 62, c63 - 63, 'A', 0, 0);
+    size_t i = 0;
+
+    // 24 bytes become 32 characters. The second load reads 4 bytes past the block.
+    for (; i + 28 <= size; i += 24, str += 32) {
+        __m128i lo = _mm_loadu_si128((__m128i *) (bin + i));
+        __m128i hi = _mm_loadu_si128((__m128i *) (bin + i + 12));
+        __m256i c = encode_avx2(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shift);
+        _mm256_storeu_si256((__m256i *) str, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(c)));
+        _mm256_storeu_si256((__m256i *) (str + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(c, 1)));
+    }
+    return i;
+}
+
+TARGET("ssse3")
+static size_t encode_blocks_ssse3(const unsigned char * bin, size_t size, unsigned short * str, int url) {
+    char c62 = url ? '-' : '+', c63 = url ? '_' : '/';
+    __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                  '0' - 52, '0' - 52, '0' - 52, c62 - 62, c63 - 63, 'A', 0, 0);
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    // 12 bytes become 16 characters. The load reads 4 bytes past the block.
+    for (; i + 16 <= size; i += 12, str += 16) {
+        __m128i c = encode_ssse3(_mm_loadu_si128((__m128i *) (bin + i)), shift);
+        _mm_storeu_si128((__m128i *) str, _mm_unpacklo_epi8(c, zero));
+        _mm_storeu_si128((__m128i *) (str + 8), _mm_unpackhi_epi8(c, zero));
+    }
+    return i;
+}
+
+static size_t encode(const unsigned char * bin, size_t size, unsigned short * str, int url) {
+    const char * a = alphabet[url];
+    unsigned short * s = str;
+    int simd = level();
+    size_t i = (simd == 2) ? encode_blocks_avx2(bin, size, s, url)
+             : (simd == 1) ? encode_blocks_ssse3(bin, size, s, url)
+             : 0;
+    s += i / 3 * 4;
+
+    for (; i + 3 <= size; i += 3, s += 4) {
+        unsigned int v = bin[i] << 16 | bin[i + 1] << 8 | bin[i + 2];
+        s[0] = a[v >> 18];
+        s[1] = a[v >> 12 & 63];
+        s[2] = a[v >> 6 & 63];
+        s[3] = a[v & 63];
+    }
+    if (i < size) {
+        unsigned int v = bin[i] << 16 | ((i + 1 < size) ? bin[i + 1] << 8 : 0);
+        *s++ = a[v >> 18];
+        *s++ = a[v >> 12 & 63];
+        *s++ = (i + 1 < size) ? a[v >> 6 & 63] : '=';
+        *s++ = '=';
+    }
+    *s = 0; // Null terminator
+    return s - str;
+}
+
+// Maps 16 characters to sextets. Returns a mask with a bit set for every invalid character.
+TARGET("ssse3")
+static int classify_ssse3(__m128i c, __m128i * out, char c62, char c63) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i is62 = _mm_cmpeq_epi8(c, _mm_set1_epi8(c62));
+    __m128i is63 = _mm_cmpeq_epi8(c, _mm_set1_epi8(c63));
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+    __m128i offset = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+        _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+            _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8(62 - c62)), _mm_and_si128(is63, _mm_set1_epi8(63 - c63)))));
+    *out = _mm_add_epi8(c, offset);
+    return _mm_movemask_epi8(valid) ^ 0xFFFF;
+}
+
+TARGET("ssse3")
+static ptrdiff_t decode_blocks_ssse3(const unsigned short * str, size_t length, unsigned char * bin, int url) {
+    char c62 = url ? '-' : '+', c63 = url ? '_' : '/';
+    size_t i = 0;
+
+    // 16 characters become 12 bytes. The store writes 4 bytes past the block.
+    for (; i + 24 <= length; i += 16, bin += 12) {
+        __m128i c = _mm_packus_epi16(_mm_loadu_si128((__m128i *) (str + i)), _mm_loadu_si128((__m128i *) (str + i + 8)));
+        __m128i v;
+        if (classify_ssse3(c, &v, c62, c63))
+            return -1;
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));  // [a b] → a << 6 | b
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));     // [ab cd] → ab << 12 | cd
+        v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *) bin, v);
+    }
+    return i;
+}
+
+TARGET("avx2")
+static ptrdiff_t decode_blocks_avx2(const unsigned short * str, size_t length, unsigned char * bin, int url) {
+    char c62 = url ? '-' : '+', c63 = url ? '_' : '/';
+    size_t i = 0;
+
+    // 32 characters become 24 bytes. The second store writes 4 bytes past the block.
+    for (; i + 40 <= length; i += 32, bin += 24) {
+        __m256i c = _mm256_packus_epi16(_mm256_loadu_si256((__m256i *) (str + i)), _mm256_loadu_si256((__m256i *) (str + i + 16)));
+        c = _mm256_permute4x64_epi64(c, 0xD8); // packus works within each 128-bit lane
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        __m256i is62 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c62));
+        __m256i is63 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(c63));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+        if (_mm256_movemask_epi8(valid) != -1)
+            return -1;
+        __m256i offset = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a'))),
+            _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')),
+                _mm256_or_si256(_mm256_and_si256(is62, _mm256_set1_epi8(62 - c62)), _mm256_and_si256(is63, _mm256_set1_epi8(63 - c63)))));
+        __m256i v = _mm256_add_epi8(c, offset);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *) bin, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *) (bin + 12), _mm256_extracti128_si256(v, 1));
+    }
+    return i;
+}
+
+// Returns the number of bytes written, or -1 if the string is not strictly valid base64.
+static ptrdiff_t decode(const unsigned short * str, size_t length, unsigned char * bin, int url) {
+    // Up to two padding characters are allowed, and only if they complete a group of four.
+    size_t pad = 0;
+    while (pad < 2 && length > 0 && str[length - 1] == '=')
+        length--, pad++;
+    if (length % 4 == 1 || (pad && (length + pad) % 4))
+        return -1;
+
+    unsigned char * b = bin;
+    int simd = level();
+    ptrdiff_t done = (simd == 2) ? decode_blocks_avx2(str, length, b, url)
+                   : (simd == 1) ? decode_blocks_ssse3(str, length, b, url)
+                   : 0;
+    if (done < 0)
+        return -1;
+    size_t i = (size_t) done;
+    b += i / 4 * 3;
+
+    for (; i + 4 <= length; i += 4) {
+        int s0 = sextet(str[i], url), s1 = sextet(str[i + 1], url), s2 = sextet(str[i + 2], url), s3 = sextet(str[i + 3], url);
+        if ((s0 | s1 | s2 | s3) < 0)
+            return -1;
+        unsigned int v = s0 << 18 | s1 << 12 | s2 << 6 | s3;
+        *b++ = v >> 16;
+        *b++ = v >> 8;
+        *b++ = v;
+    }
+    if (i < length) {
+        // The unused low bits of the last character must be zero.
+        int s0 = sextet(str[i], url), s1 = sextet(str[i + 1], url), s2 = (i + 2 < length) ? sextet(str[i + 2], url) : 0;
+        if ((s0 | s1 | s2) < 0)
+            return -1;
+        unsigned int v = s0 << 18 | s1 << 12 | s2 << 6;
+        if (v & ((i + 2 < length) ? 0xFF : 0xFFFF))
+            return -1;
+        *b++ = v >> 16;
+        if (i + 2 < length)
+            *b++ = v >> 8;
+    }
+    return b - bin;
+}
+
+// op 0: Encodes size bytes of src into dst, which holds 4 * ceil(size / 3) + 1 characters. Returns the length.
+// op 1: Decodes size characters of src into dst, which holds 3 * ceil(size / 4) + 4 bytes. Returns the size or -1.
+ptrdiff_t base64(int op, void * src, size_t size, void * dst, int url) {
+    url = (url != 0);
+    return (op == 0) ? (ptrdiff_t) encode(src, size, dst, url) : decode(src, size, dst, url);
+}
@@ -0,0 +1,37 @@
+// Compares the visible pixels of two images of the same size, one row at a time, so the padding at the end
+// of each row is never read. Strides are in bytes and may differ.
+// Returns the index y * width + x of the first pixel that differs, or width * height if the images are equal.
+#include <emmintrin.h>
+
+unsigned int bitmapequal(unsigned int * a, unsigned int * b, unsigned int width, unsigned int height, unsigned int stride1, unsigned int stride2) {
+
+    // Rows without padding on either side are compared as one long row.
+    if (stride1 == 4 * width && stride2 == 4 * width) {
+        width *= height;
+        height = 1;
+    }
+
+    stride1 /= 4;
+    stride2 /= 4;
+
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned int * p = a + y * stride1;
+        unsigned int * q = b + y * stride2;
+        unsigned int x = 0;
+
+        // Eight pixels at a time. Equal images are read to the end, so only the rare difference is located.
+        for (; x + 8 <= width; x += 8) {
+            __m128i v1 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (p + x)), _mm_loadu_si128((__m128i *) (q + x)));
+            __m128i v2 = _mm_xor_si128(_mm_loadu_si128((__m128i *) (p + x + 4)), _mm_loadu_si128((__m128i *) (q + x + 4)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_or_si128(v1, v2), _mm_setzero_si128())) != 0xFFFF)
+                break;
+        }
+
+        // Finds the pixel within the last eight, or cleans up the remaining pixels.
+        for (; x < width; x++)
+            if (p[x] != q[x])
+                return y * width + x;
+    }
+
+    return width * height;
+}
@@ -0,0 +1,92 @@
+// Frame channel in shared memory for one writer process and any number of reader processes.
+// The channel is a single block with no pointers, so it can be mapped at a different address in each process:
+// a 64 byte header, one 64 byte line per slot, then the pixels of every slot.
+// Each slot is guarded by a sequence lock. The writer makes the sequence odd, copies the frame, and makes
+// it even again. A reader copies the newest frame and keeps it only if the sequence was even and unchanged
+// across the copy, so readers never block the writer or each other and never keep a torn frame.
+// The writer cycles through the slots, so a reader has (slots - 1) frame intervals to finish its copy.
+// Only compiler builtins are used, so this file builds for Windows machine code and for tests on Linux.
+
+#define CHANNEL_MAGIC 0x4E484346 // FCHN
+
+struct slot {
+    unsigned int sequence;           // Odd while the writer is copying into the slot
+    unsigned int frame;              // Frame number held by the slot
+    unsigned int reserved[14];       // One cache line per slot
+};
+
+struct channel {
+    unsigned int magic;              // FCHN
+    unsigned int header;             // Bytes before the pixels of the first slot
+    unsigned int width, height, stride; // Frame dimensions, stride in bytes
+    unsigned int format;             // Format32bppArgb
+    unsigned int slots;              // Number of slots
+    unsigned int size;               // Bytes per slot, at least stride × height
+    unsigned int latest;             // Frame number of the newest published frame, or 0
+    unsigned int readers;            // Attached reader processes
+    unsigned int reserved[6];
+    struct slot slot[];
+};
+
+static void copy(const struct channel * c, unsigned char * dst, int dst_pitch, const unsigned char * src, int src_pitch) {
+    for (unsigned int y = 0; y < c->height; y++) {
+        const unsigned int * s = (const unsigned int *) (src + (int) y * src_pitch);
+        unsigned int * d = (unsigned int *) (dst + (int) y * dst_pitch);
+        for (unsigned int x = 0; x < c->width; x++)
+            d[x] = s[x];
+    }
+}
+
+static unsigned char * pixels_of(struct channel * c, unsigned int i) {
+    return (unsigned char *) c + c->header + i * c->size;
+}
+
+static unsigned int publish(struct channel * c, const unsigned char * src, int pitch) {
+    // Frame numbers skip 0, which means that nothing has been published.
+    unsigned int frame = c->latest + 1;
+    frame += (frame == 0);
+    unsigned int i = frame % c->slots;
+    struct slot * s = c->slot + i;
+    unsigned int sequence = s->sequence;
+
+    __atomic_store_n(&s->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    copy(c, pixels_of(c, i), c->stride, src, pitch);
+    __atomic_store_n(&s->frame, frame, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&c->latest, frame, __ATOMIC_RELEASE);
+    return frame;
+}
+
+static unsigned int snapshot(struct channel * c, unsigned char * dst, int pitch, unsigned int since) {
+    for (;;) {
+        unsigned int frame = __atomic_load_n(&c->latest, __ATOMIC_ACQUIRE);
+        if (frame == since || frame == 0)
+            return 0;
+
+        unsigned int i = frame % c->slots;
+        struct slot * s = c->slot + i;
+        unsigned int before = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+        if ((before & 1) || __atomic_load_n(&s->frame, __ATOMIC_RELAXED) != frame)
+            continue; // The writer has moved on to this slot. Start over with the newest frame.
+
+        copy(c, dst, pitch, pixels_of(c, i), c->stride);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->sequence, __ATOMIC_RELAXED) == before)
+            return frame;
+    }
+}
+
+// op 0: Copies the pixels into the next slot and publishes them. Returns the frame number.
+// op 1: Copies the newest frame into the pixels if it is not frame since. Returns its frame number, or 0.
+// op 2: Attaches a reader. Returns the number of readers.
+// op 3: Detaches a reader. Returns the number of readers.
+unsigned int channel(struct channel * c, int op, unsigned char * pixels, int pitch, unsigned int since) {
+    switch (op) {
+        case 0: return publish(c, pixels, pitch);
+        case 1: return snapshot(c, pixels, pitch, since);
+        case 2: return __atomic_add_fetch(&c->readers, 1, __ATOMIC_RELAXED);
+        case 3: return __atomic_sub_fetch(&c->readers, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Composites a rectangle of 32-bit ARGB over another, in place, for layering overlays without GDI+.
+// Both images are premultiplied (PBGRA) or both are straight (BGRA). Straight pixels are premultiplied, blended,
+// and divided by their alpha again. The source alpha is first scaled by opacity. Modes on premultiplied Sc, Sa
+// over Dc, Da, with × rounded exactly as (a × b + 127) / 255 and results clamped to 255:
+//   0 - over       Sc + Dc × (255 - Sa)
+//   1 - multiply   Sc × Dc + Sc × (255 - Da) + Dc × (255 - Sa)
+//   2 - screen     Sc + Dc - Sc × Dc
+//   3 - add        Sc + Dc
+// Alpha takes the same formula as the colors. Straight pixels with no alpha leave the destination as it was.
+// The mode is the pass, over the rows [first, last), so it can be split across threads.
+#include <emmintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+
+struct composite {
+    unsigned int * dst;             // Top left pixel of the destination rectangle (ARGB), written in place
+    unsigned int * src;             // Top left pixel of the source rectangle
+    unsigned int width, height;     // Rectangle dimensions
+    unsigned int dstride, sstride;  // Strides in bytes
+    unsigned int opacity;           // 0 to 255
+    unsigned int premultiplied;     // 1 = PBGRA, 0 = BGRA
+    unsigned int mode;              // 0 = over, 1 = multiply, 2 = screen, 3 = add, given as the pass of ImagePut.Parallel
+    unsigned int first, last;       // Rows of this thread
+};
+
+// (a × b + 127) / 255 for 16-bit lanes up to 255, without a division. This is exactly (x + x / 256) / 256 for
+// x = a × b + 128, and the high half of x × 257 computes that in one instruction.
+static __m128i mul(__m128i a, __m128i b) {
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+    return _mm_mulhi_epu16(x, _mm_set1_epi16(257));
+}
+
+static __m128i alpha(__m128i v) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF);
+}
+
+static __m128i pick(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Rounds each color of 4 premultiplied pixels to (c × 255 + a / 2) / a. Every mode keeps the colors of straight
+// pixels at most their alpha, so the results fit in a byte. Results with no alpha come from transparent sources,
+// which keep the destination instead.
+static __m128i divide_alpha(__m128i p) {
+    __m128i ff = _mm_set1_epi32(0xFF), a = _mm_srli_epi32(p, 24), half = _mm_srli_epi32(a, 1);
+    __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(a));
+    __m128i out = _mm_slli_epi32(a, 24);
+
+    // One division serves all 3 colors. Products below 256 are within 1/10000 of the quotient, and the quotient
+    // is an integer or at least 1/255 below one, so adding 1/512 before truncating gives the exact floor.
+    for (int k = 0; k < 24; k += 8) {
+        __m128i c = _mm_and_si128(_mm_srli_epi32(p, k), ff);
+        __m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(c, 8), c), half);
+        __m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(n), inverse), _mm_set1_ps(1.0f / 512)));
+        out = _mm_or_si128(out, _mm_slli_epi32(q, k));
+    }
+    return out;
+}
+
+// Blends 2 pixels in 16-bit lanes into premultiplied pixels. Clear marks pixels with no alpha from src.
+static __m128i blend(struct composite * r, __m128i s, __m128i d, __m128i * clear) {
+    __m128i lane = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), full = _mm_set1_epi16(255);
+    __m128i opacity = _mm_set1_epi16(r->opacity), sa, x;
+
+    if (r->premultiplied)
+        s = mul(s, opacity), sa = alpha(s);
+    else {
+        sa = mul(alpha(s), opacity);
+        s = pick(lane, sa, mul(s, sa));
+        d = pick(lane, d, mul(d, alpha(d)));
+    }
+
+    if (r->mode == 0)
+        x = _mm_add_epi16(s, mul(d, _mm_sub_epi16(full, sa)));
+    else if (r->mode == 1)
+        x = _mm_add_epi16(_mm_add_epi16(mul(s, d), mul(s, _mm_sub_epi16(full, alpha(d)))), mul(d, _mm_sub_epi16(full, sa)));
+    else if (r->mode == 2)
+        x = _mm_sub_epi16(_mm_add_epi16(s, d), mul(s, d));
+    else
+        x = _mm_add_epi16(s, d);
+    *clear = _mm_cmpeq_epi16(sa, _mm_setzero_si128());
+    return _mm_min_epi16(x, full);
+}
+
+static __m128i blend4(struct composite * r, __m128i s, __m128i d) {
+    __m128i zero = _mm_setzero_si128(), clear[2];
+    __m128i x = _mm_packus_epi16(blend(r, _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), &clear[0]),
+                                 blend(r, _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), &clear[1]));
+    if (r->premultiplied)
+        return x;
+    return pick(_mm_packs_epi16(clear[0], clear[1]), d, divide_alpha(x));
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int composite(struct composite * r) {
+    __m128i alphas = _mm_set1_epi32(0xFF000000), zero = _mm_setzero_si128();
+
+    // Opaque pixels drawn over are copied. Transparent pixels change nothing.
+    __m128i visible = r->premultiplied ? _mm_set1_epi32(-1) : alphas;
+    int copy = (r->mode == 0 && r->opacity == 255);
+
+    for (unsigned int y = r->first; y < r->last; y++) {
+        unsigned int * src = (unsigned int *) ((unsigned char *) r->src + (size_t) y * r->sstride);
+        unsigned int * dst = (unsigned int *) ((unsigned char *) r->dst + (size_t) y * r->dstride);
+        unsigned int x = 0;
+
+        for (; x + 4 <= r->width; x += 4) {
+            __m128i s = _mm_loadu_si128((__m128i *) (src + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, visible), zero)) == 0xFFFF)
+                continue;
+            if (copy && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphas), alphas)) == 0xFFFF)
+                _mm_storeu_si128((__m128i *) (dst + x), s);
+            else
+                _mm_storeu_si128((__m128i *) (dst + x), blend4(r, s, _mm_loadu_si128((__m128i *) (dst + x))));
+        }
+
+        // The last few pixels go through a copy, so no vector reaches past the row.
+        if (x < r->width) {
+            unsigned int s[4] = {0}, d[4] = {0}, n = r->width - x;
+            for (unsigned int i = 0; i < n; i++)
+                s[i] = src[x + i], d[i] = dst[x + i];
+            _mm_storeu_si128((__m128i *) d, blend4(r, _mm_loadu_si128((__m128i *) s), _mm_loadu_si128((__m128i *) d)));
+            for (unsigned int i = 0; i < n; i++)
+                dst[x + i] = d[i];
+        }
+    }
+    return 0;
+}
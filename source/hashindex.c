@@ -0,0 +1,125 @@
+// Finds the 64-bit hashes within a Hamming distance of a query by multi-index hashing.
+// Each hash is split into four 16-bit keys, and each key has a table of the hashes sorted by it. If two hashes
+// differ in at most radius bits, then one of their four keys differs in at most radius / 4 bits, so a query only
+// visits the buckets of keys near its own. Radii of 12 bits and up compare every hash instead.
+// The tables are plain arrays of 32-bit offsets and positions, so a saved index can be used straight from a
+// mapped file.
+//   op 0 - Builds the tables from hashes, sorting by each key with a counting sort.
+//   op 1 - Finds the hashes within radius bits of hash. Writes the position and distance of the first limit to
+//          results, in no particular order, and returns how many there are.
+
+#define HASHINDEX_BUCKETS 65536
+
+struct hashindex {
+    unsigned long long * hashes; // count hashes, in the order they were added
+    unsigned int * offsets;      // For each key, the start of each of its buckets, and the end of the last
+    unsigned int * positions;    // For each key, count positions into hashes, sorted by bucket
+    unsigned int count;
+};
+
+static unsigned int distance(unsigned long long a, unsigned long long b) {
+    // Adds the bits of each half in parallel, since 32-bit code has no 64-bit popcount.
+    unsigned int n = 0;
+    for (int half = 0; half < 2; half++) {
+        unsigned int v = (unsigned int) ((a ^ b) >> (32 * half));
+        v = v - (v >> 1 & 0x55555555);
+        v = (v & 0x33333333) + (v >> 2 & 0x33333333);
+        n += ((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101 >> 24;
+    }
+    return n;
+}
+
+static unsigned int key(unsigned long long hash, unsigned int t) {
+    return (unsigned int) (hash >> (16 * t)) & 0xFFFF;
+}
+
+static unsigned int ones(unsigned int v) {
+    return distance(v, 0);
+}
+
+unsigned int hashindex(struct hashindex * index, int op, unsigned long long hash, unsigned int radius, unsigned int * results, unsigned int limit) {
+    unsigned int count = index->count, found = 0;
+
+    if (op == 0) {
+        for (unsigned int t = 0; t < 4; t++) {
+            unsigned int * offsets = index->offsets + t * (HASHINDEX_BUCKETS + 1);
+            unsigned int * positions = index->positions + t * count;
+
+            // Count each bucket, then turn the counts into the start of each bucket.
+            for (unsigned int k = 0; k <= HASHINDEX_BUCKETS; k++)
+                offsets[k] = 0;
+            for (unsigned int i = 0; i < count; i++)
+                offsets[key(index->hashes[i], t) + 1]++;
+            for (unsigned int k = 0; k < HASHINDEX_BUCKETS; k++)
+                offsets[k + 1] += offsets[k];
+
+            // Placing each position advances the start of its bucket to the start of the next.
+            for (unsigned int i = 0; i < count; i++)
+                positions[offsets[key(index->hashes[i], t)]++] = i;
+            for (unsigned int k = HASHINDEX_BUCKETS; k > 0; k--)
+                offsets[k] = offsets[k - 1];
+            offsets[0] = 0;
+        }
+        return count;
+    }
+
+    // The number of keys within reach of each of the four keys of the query.
+    unsigned int reach = radius / 4, probes = 0;
+    for (unsigned int w = 0, choose = 1; w <= reach && w <= 16; w++) {
+        probes += choose;
+        choose = choose * (16 - w) / (w + 1);
+    }
+
+    // The four keys visit about 4 * probes / 65536 of the hashes, in no order. From a reach of three bits on,
+    // or when there are few hashes per bucket visited, it is as fast to compare every hash.
+    if (reach >= 3 || count <= 8 * probes) {
+        for (unsigned int i = 0; i < count; i++) {
+            unsigned int d = distance(hash, index->hashes[i]);
+            if (d <= radius) {
+                if (found < limit)
+                    results[2 * found] = i, results[2 * found + 1] = d;
+                found++;
+            }
+        }
+        return found;
+    }
+
+    for (unsigned int t = 0; t < 4; t++) {
+        unsigned int * offsets = index->offsets + t * (HASHINDEX_BUCKETS + 1);
+        unsigned int * positions = index->positions + t * count;
+
+        // Visit every key that differs from the key of the query in at most reach bits, fewest first.
+        // Masks of w bits are enumerated in order with Gosper's hack.
+        for (unsigned int w = 0; w <= reach; w++) {
+            for (unsigned int mask = (1u << w) - 1; mask < HASHINDEX_BUCKETS; ) {
+                unsigned int k = key(hash, t) ^ mask;
+
+                for (unsigned int j = offsets[k]; j < offsets[k + 1]; j++) {
+                    unsigned int i = positions[j];
+                    unsigned long long h = index->hashes[i];
+
+                    // A hash within reach on an earlier key was already seen there.
+                    unsigned int seen = 0;
+                    for (unsigned int s = 0; s < t; s++)
+                        seen |= ones(key(h ^ hash, s)) <= reach;
+                    if (seen)
+                        continue;
+
+                    unsigned int d = distance(hash, h);
+                    if (d <= radius) {
+                        if (found < limit)
+                            results[2 * found] = i, results[2 * found + 1] = d;
+                        found++;
+                    }
+                }
+
+                if (mask == 0)
+                    break;
+                unsigned int low = mask & -mask, ripple = mask + low;
+                mask = (((ripple ^ mask) >> 2) / low) | ripple;
+            }
+        }
+    }
+
+    return found;
+}
@@ -1,17 +1,181 @@
-#include <stdio.h>
-
-void hex(char * hex, unsigned char * bin, size_t size, char * str, size_t length) {
-    unsigned char * start = bin;
-    unsigned char * end = bin + size;
-    char high, low;
-    char * s = str;
-
-    while(start < end) {
-        high = (*start >> 4) & 0xF;
-        *s = *(hex + high);
-        low = *start & 0xF;
-        *(s + 1) = *(hex + low);
-        start += 1;
-        s += 2;
+// Hexadecimal encoder and decoder for UTF-16 strings. Replaces CryptStringToBinary in HexToStream.
+// The encoder splits each byte into nibbles and maps them to characters with pshufb.
+// The decoder classifies each character with range compares, so invalid characters are always rejected,
+// and joins pairs of nibbles with pmaddubsw. AVX2 is used when the OS supports it.
+#include <cpuid.h>
+#include <immintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+typedef __PTRDIFF_TYPE__ ptrdiff_t;
+
+// The ABI is a target option, so target() would reset -mabi=ms on these functions but not on their callers.
+#ifdef __x86_64__
+#define TARGET(isa) __attribute__((target(isa), ms_abi))
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// 0 = scalar, 1 = SSSE3, 2 = AVX2
+static int level(void) {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3))
+        return 0;
+    if ((c & bit_OSXSAVE) && (c & bit_AVX)) {
+        unsigned int lo, hi;
+        __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        if ((lo & 6) == 6 && __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & bit_AVX2))
+            return 2;
+    }
+    return 1;
+}
+
+static const char digits[2][16] = {"0123456789abcdef", "0123456789ABCDEF"};
+
+static int nibble(unsigned short c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+TARGET("ssse3")
+static size_t encode_blocks_ssse3(const unsigned char * bin, size_t size, unsigned short * str, int upper) {
+    __m128i lut = _mm_loadu_si128((__m128i *) digits[upper]);
+    __m128i mask = _mm_set1_epi8(0x0F), zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    // 16 bytes become 32 characters.
+    for (; i + 16 <= size; i += 16, str += 32) {
+        __m128i v = _mm_loadu_si128((__m128i *) (bin + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        __m128i c0 = _mm_unpacklo_epi8(hi, lo), c1 = _mm_unpackhi_epi8(hi, lo);
+        _mm_storeu_si128((__m128i *) str, _mm_unpacklo_epi8(c0, zero));
+        _mm_storeu_si128((__m128i *) (str + 8), _mm_unpackhi_epi8(c0, zero));
+        _mm_storeu_si128((__m128i *) (str + 16), _mm_unpacklo_epi8(c1, zero));
+        _mm_storeu_si128((__m128i *) (str + 24), _mm_unpackhi_epi8(c1, zero));
+    }
+    return i;
+}
+
+TARGET("avx2")
+static size_t encode_blocks_avx2(const unsigned char * bin, size_t size, unsigned short * str, int upper) {
+    __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *) digits[upper]));
+    __m256i mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+
+    // 32 bytes become 64 characters.
+    for (; i + 32 <= size; i += 32, str += 64) {
+        // Unpacking works within each 128-bit lane, so place bytes 0-7 and 16-23 in the low lane.
+        __m256i v = _mm256_permute4x64_epi64(_mm256_loadu_si256((__m256i *) (bin + i)), 0xD8);
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        __m256i c0 = _mm256_unpacklo_epi8(hi, lo), c1 = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *) str, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(c0)));
+        _mm256_storeu_si256((__m256i *) (str + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(c0, 1)));
+        _mm256_storeu_si256((__m256i *) (str + 32), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(c1)));
+        _mm256_storeu_si256((__m256i *) (str + 48), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(c1, 1)));
+    }
+    return i;
+}
+
+static size_t encode(const unsigned char * bin, size_t size, unsigned short * str, int upper) {
+    const char * d = digits[upper];
+    int simd = level();
+    size_t i = (simd == 2) ? encode_blocks_avx2(bin, size, str, upper)
+             : (simd == 1) ? encode_blocks_ssse3(bin, size, str, upper)
+             : 0;
+
+    for (; i < size; i++) {
+        str[2 * i] = d[bin[i] >> 4];
+        str[2 * i + 1] = d[bin[i] & 15];
     }
-}
\ No newline at end of file
+    str[2 * size] = 0; // Null terminator
+    return 2 * size;
+}
+
+// Maps 16 characters to nibbles. Returns a mask with a bit set for every invalid character.
+TARGET("ssse3")
+static int classify_ssse3(__m128i c, __m128i * out) {
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i l = _mm_or_si128(c, _mm_set1_epi8(0x20)); // Lowercase
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(l, _mm_set1_epi8('f' + 1)));
+    *out = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                        _mm_and_si128(alpha, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
+    return _mm_movemask_epi8(_mm_or_si128(digit, alpha)) ^ 0xFFFF;
+}
+
+TARGET("ssse3")
+static ptrdiff_t decode_blocks_ssse3(const unsigned short * str, size_t length, unsigned char * bin) {
+    __m128i weights = _mm_set1_epi16(0x0110); // [hi lo] → hi << 4 | lo
+    size_t i = 0;
+
+    // 32 characters become 16 bytes.
+    for (; i + 32 <= length; i += 32, bin += 16) {
+        __m128i c0 = _mm_packus_epi16(_mm_loadu_si128((__m128i *) (str + i)), _mm_loadu_si128((__m128i *) (str + i + 8)));
+        __m128i c1 = _mm_packus_epi16(_mm_loadu_si128((__m128i *) (str + i + 16)), _mm_loadu_si128((__m128i *) (str + i + 24)));
+        __m128i v0, v1;
+        if (classify_ssse3(c0, &v0) | classify_ssse3(c1, &v1))
+            return -1;
+        v0 = _mm_maddubs_epi16(v0, weights);
+        v1 = _mm_maddubs_epi16(v1, weights);
+        _mm_storeu_si128((__m128i *) bin, _mm_packus_epi16(v0, v1));
+    }
+    return i;
+}
+
+TARGET("avx2")
+static ptrdiff_t decode_blocks_avx2(const unsigned short * str, size_t length, unsigned char * bin) {
+    __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+
+    // 64 characters become 32 bytes.
+    for (; i + 64 <= length; i += 64, bin += 32) {
+        __m256i v[2];
+        for (int k = 0; k < 2; k++) {
+            const unsigned short * s = str + i + 32 * k;
+            __m256i c = _mm256_packus_epi16(_mm256_loadu_si256((__m256i *) s), _mm256_loadu_si256((__m256i *) (s + 16)));
+            c = _mm256_permute4x64_epi64(c, 0xD8); // packus works within each 128-bit lane
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+            __m256i l = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+            __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(l, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), l));
+            if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1)
+                return -1;
+            c = _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+                                _mm256_and_si256(alpha, _mm256_sub_epi8(l, _mm256_set1_epi8('a' - 10))));
+            v[k] = _mm256_maddubs_epi16(c, weights);
+        }
+        __m256i out = _mm256_permute4x64_epi64(_mm256_packus_epi16(v[0], v[1]), 0xD8);
+        _mm256_storeu_si256((__m256i *) bin, out);
+    }
+    return i;
+}
+
+// Returns the number of bytes written, or -1 if the string is not strictly valid hexadecimal.
+static ptrdiff_t decode(const unsigned short * str, size_t length, unsigned char * bin) {
+    if (length % 2)
+        return -1;
+
+    int simd = level();
+    ptrdiff_t done = (simd == 2) ? decode_blocks_avx2(str, length, bin)
+                   : (simd == 1) ? decode_blocks_ssse3(str, length, bin)
+                   : 0;
+    if (done < 0)
+        return -1;
+    size_t i = (size_t) done;
+
+    for (; i < length; i += 2) {
+        int hi = nibble(str[i]), lo = nibble(str[i + 1]);
+        if ((hi | lo) < 0)
+            return -1;
+        bin[i / 2] = hi << 4 | lo;
+    }
+    return length / 2;
+}
+
+// op 0: Encodes size bytes of src into dst, which holds 2 * size + 1 characters. Returns the length.
+// op 1: Decodes size characters of src into dst, which holds size / 2 bytes. Returns the size or -1.
+ptrdiff_t hex(int op, void * src, size_t size, void * dst, int upper) {
+    upper = (upper != 0);
+    return (op == 0) ? (ptrdiff_t) encode(src, size, dst, upper) : decode(src, size, dst);
+}
@@ -1,170 +1,71 @@
-__attribute__((ms_abi))  // Tells GCC we want to compile for Windows.
-__attribute__ ((target ("sse4.2")))  // According to godbolt.org it doesn't do anything even with
-                                     // __builtin_assume_aligned(ptr, 16) and -Ofast -msse4.2.
-                                     // You might want to study SIMD instructions and if there is a good instruction to
-                                     // take advantage of, go with inline assembly.
-unsigned int imagesearch2(unsigned int * restrict result, unsigned int * start, unsigned int width, unsigned int height, unsigned int * s, unsigned int w, unsigned int h, unsigned int coord_focus, unsigned short variation) {
-    // width, height, start, current, end, color refer to the haystack (main image)
-    // x, y, w, h, s, c, e, cf refer to the needle (search image)
-    // The location of the focused pixel
-    unsigned short x;
-    unsigned short y;
-
-    if ( coord_focus ) {
-        x = coord_focus >> sizeof(x)*8;
-        y = coord_focus & 0x0000ffff;
-        goto focus_determined;
-    }
-
-    // Try to locate the focused pixel in the middle of the sprite
-    unsigned int * c = s + w/4 + h/4 * w;
-    unsigned int * last_pixel = s + h * w;
-    while(c < last_pixel) {
-        for (unsigned int * e = c + w / 2; c < e; c++) {
-            if ( *((unsigned char *) c + 3) ) {
-                unsigned int offset = (c - s);
-                x = offset % w;
-                y = offset / w;
-                goto focus_determined;
-            }
-        }
-        c += w / 2;
-    }
-
-    // If every pixel in the middle was transparent
-    // try to find a non-transparent pixel on the left-hand side.
-
-    // This falls into an infinite loop if somehow the sprite doesn't have any
-    // non-transparent pixel in the leftmost quarter.
-    c = s + (w/4-1) + (h-1) * w;
-    while(-1) {
-        for (unsigned int * e = c - w / 4; c > e; c--) {
-            if ( *((unsigned char *) c + 3) ) {
-                unsigned int offset = (c - s);
-                x = offset % w;
-                y = offset / w;
-                goto focus_determined;
-            }
-        }
-        c -= w - w / 4;
+#include "imagesearch_stats.h"
+
+// Returns true if the blue, green, and red channels each differ by no more than the variation.
+static inline int within(unsigned int a, unsigned int b, unsigned int v) {
+    for (int k = 0; k < 24; k += 8) {
+        int d = (int) (a >> k & 0xFF) - (int) (b >> k & 0xFF);
+        if (d > (int) v || d < -(int) v)
+            return 0;
     }
+    return 1;
+}
 
-    focus_determined:;
-
-    // Stash the coordinates of the focused pixel
-    *(result + 2) = x << sizeof(x)*8 | y;
-
-
-
-    // Prepare the search.
-
-    // The color on the focused pixel
-    unsigned int cf = *(s + x + y * w);
+unsigned int * imagesearch2(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y, unsigned short variation, struct imagesearch_stats * stats) {
+    // source: left, top, width, height, stride, start, current refer to the haystack (main image)
+    // target: x, y, w, h, pitch, s, c refer to the needle (search or template image)
+    // Strides are in bytes so that either image can be a view into a larger parent buffer.
 
-    // We don't need to search in the narrow edge on the right-hand side
-    unsigned int range_width = width - w;
-    // Remaining area must be greater than search height
-    unsigned int range_height = height - h;
+    if (w > width || h > height)
+        return 0;
 
-    unsigned int * current = start;
-    unsigned int * end = start + width * range_height + width;
+    stride /= 4;                                    // Convert to pixels for pointer arithmetic
+    pitch /= 4;
 
-    // Start the search.
-    unsigned int left = 0;
-    while ( current < end ) {
+    int blind = (*((unsigned char *) (s + x + y * pitch) + 3) == 0);
+    unsigned int cf = *(s + x + y * pitch);         // Focused pixel
 
-        unsigned int offset = current - start;
-        //unsigned int left = offset % width;
-        // TODO Remove the comment below
-        // I believe div is worse than cmov'ing one constant number.
-        // The code loses some readability though.
-        unsigned int top = offset / width;  // optimized away
+    unsigned int * found = 0;
+    unsigned int top, left, anchors = 0;
 
-        // Checks before subimage loop.
+    for (top = 0; top <= height - h; top++) {
+        unsigned int * row = start + top * stride;
 
-        // X-Range Check
-        if ( left > range_width ) {
-            current += w - 1;
-            left = 0;
-            continue;
-        }
-        // 
+        for (left = 0; left <= width - w; left++) {
+            unsigned int * current = row + left;
 
-        // Focused Pixel
-        unsigned int * color;
-        color = current + x + y * width;
-        if ( variation == 0 ) {
-            if ( cf != *color ) {
-                current++;
-                left++;
-                goto next;
-            }
-        } else {
-            for (int b = 0; b < 3; b++) {
-                unsigned short diff = *((unsigned char *)&cf + b) - *((unsigned char *)color + b);
-                if ( diff > variation && diff < (unsigned short)(0 - variation) ) {
-                    current++;
-                    left++;
-                    goto next;
-                }
-            }
-        }
+            // The focused pixel is checked first to reject most positions early.
+            if (blind || within(cf, *(current + x + y * stride), variation)) {
+                anchors++;
 
-        // Subimage loop.
-        c = s;
-        color = current;
-        for (int i = 0; i < h; i++) {
-            unsigned int * e = c + w;
-            while (c < e) {
-                if ( *((unsigned char *) c + 3) ) {  // Skip transparent pixels
-                    if ( variation == 0 ) {
-                        if ( *c != *color ) {
-                            current++;
-                            left++;
-                            goto next;
-                        }
-                    } else {
-                        for (int b = 0; b < 3; b++) {
-                            unsigned short diff = *((unsigned char *) c + b) - *((unsigned char *) color + b);
-                            if ( diff > variation && diff < (unsigned short)(0 - variation) ) {
-                                current++;
-                                left++;
+                // Subimage matching loop.
+                for (unsigned int i = 0; i < h; i++) {
+                    unsigned int * c = s + i * pitch;
+                    unsigned int * p = current + i * stride;
+                    for (unsigned int j = 0; j < w; j++) {
+                        if (*((unsigned char *) (c + j) + 3)) // Skip transparent pixels
+                            if (!within(c[j], p[j], variation)) {
+                                if (stats)
+                                    stats->rejections[i < 15 ? i : 15]++;
                                 goto next;
                             }
-                        }
                     }
                 }
-                c++;  // Iterate over the needle image
-                color++;  // Iterate over the haystack image
+                found = current;
+                goto done;
             }
-            color = color - w + width;  // Reset pointer for each scanline
-        }
-
-        // Found a matching image!
-        *(result) = (current - start) % width;
-        *(result + 1) = (current - start) / width;
-        return 1;
 
-        next:
-        if ( left >= width ) {
-            left = 0;
+            next:;
         }
     }
 
-// TODO Remove the comment below for clean code
-//
-// This is how I checked the input data, writing the first few pixels at s or start
-// and then ImagePutClipboard and check each pixel's color in GIMP.
-//
-// It seems loading with ({sprite: fpath}) gives you the right buffer but
-// loading with (fpath, transparent_color) gives a buffer with no transparent pixels
-// even if the file had pixels with the matching transparent_color.
-//
-//for ( unsigned int k = 0; k < w*h/2; k++ ) {
-//  *(result+k) = *(s + k%32);
-//}
-//return (w*h)/2/2;
-//
+    done:
+    if (stats) {
+        // The focused pixel is the only anchor, so every anchor is verified.
+        stats->positions += found ? top * (width - w + 1) + left + 1 : (height - h + 1) * (width - w + 1);
+        stats->anchors += anchors;
+        stats->verifications += anchors;
+        stats->results += (found != 0);
+    }
 
-    return 0;
+    return found; // Null if not found
 }
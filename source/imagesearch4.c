@@ -0,0 +1,100 @@
+// Exact search that stays fast on repetitive haystacks.
+// It starts like imagesearch1, checking the focused and top-left pixels before comparing the needle.
+// On tiled backgrounds and spreadsheets those anchors match almost everywhere and most positions are
+// compared for many pixels. Once the comparisons cost more than a few pixels per position, the rest
+// of the haystack is searched with a 2D rolling hash (Rabin-Karp) instead:
+// Each row of w pixels is hashed as a polynomial, and the hashes of h consecutive rows are combined the
+// same way down each column. Sliding right updates a row hash with one pixel leaving and one entering,
+// and sliding down updates a column hash with one row leaving and one entering, so every position costs
+// the same few multiplies whatever the content. Only positions whose hash equals the needle's are compared.
+// Arithmetic wraps modulo 2³², which the comparison makes safe.
+// The caller provides width - w + 1 unsigned integers of scratch for the column hashes.
+// Transparent pixels would be hashed as colors, so needles with them never switch and behave as imagesearch1.
+
+#include "imagesearch_stats.h"
+
+#include "rolling_hash.h"
+
+unsigned int * imagesearch4(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y, unsigned int * columns, struct imagesearch_stats * stats) {
+    // source: left, top, width, height, stride, start, current refer to the haystack (main image)
+    // target: x, y, w, h, pitch, s refer to the needle (search or template image)
+    // Strides are in bytes so that either image can be a view into a larger parent buffer.
+    // When hashing, a position whose hash equals the needle's counts as an anchor and a verification.
+
+    if (w > width || h > height)
+        return 0;
+
+    stride /= 4;                                    // Convert to pixels for pointer arithmetic
+    pitch /= 4;
+
+    int trans = (*((unsigned char *) s + 3) == 0);  // Check if top-left pixel is transparent
+    int blind = (*((unsigned char *) (s + x + y * pitch) + 3) == 0);
+
+    unsigned int c1 = *(s);                         // Top-left pixel
+    unsigned int c4 = *(s + x + y * pitch);         // Focused pixel
+
+    unsigned int n = width - w + 1;                 // Positions per row
+    unsigned int work = 0;                          // Pixels compared after the anchors matched
+    int hashable = opaque(s, w, h, pitch), hashing = 0;
+
+    unsigned int bw = power(ROW_BASE, w - 1);       // Weight of the pixel leaving a row
+    unsigned int ch = power(COLUMN_BASE, h - 1);    // Weight of the row leaving a column
+    unsigned int target = needle_hash(s, w, h, pitch);
+
+    unsigned int * found = 0;
+    unsigned int top, left, anchors = 0, verifications = 0;
+
+    for (top = 0; top <= height - h; top++) {
+        unsigned int * row = start + top * stride;
+
+        for (left = 0; left < n; left++) {
+            unsigned int * current = row + left;
+            unsigned int compared;
+
+            if (hashing) {
+                if (columns[left] != target)
+                    continue;
+                anchors++;
+            }
+            else {
+                if (!blind && c4 != *(current + x + y * stride)) // Rank 1 - Focused Pixel
+                    continue;
+                anchors++;
+                if (!trans && c1 != *(current))                  // Rank 2 - Top-left Pixel
+                    continue;
+            }
+
+            verifications++;
+            if (!(compared = differ(current, stride, s, w, h, pitch))) {
+                found = current;
+                goto done;
+            }
+            work += compared;
+            if (stats) {
+                unsigned int i = (compared - 1) / w;
+                stats->rejections[i < 15 ? i : 15]++;
+            }
+        }
+
+        if (top == height - h)
+            break;
+
+        // Switch when the comparisons average more than 4 pixels per position.
+        if (hashing)
+            next_row(columns, row, width, stride, w, h, bw, ch);
+        else if (hashable && work / 4 > n * (top + 1)) {
+            hashing = 1;
+            first_rows(columns, row + stride, width, stride, w, h, bw);
+        }
+    }
+
+    done:
+    if (stats) {
+        stats->positions += found ? top * n + left + 1 : (height - h + 1) * n;
+        stats->anchors += anchors;
+        stats->verifications += verifications;
+        stats->results += (found != 0);
+    }
+
+    return found; // Null if not found
+}
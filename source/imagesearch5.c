@@ -0,0 +1,99 @@
+#include "imagesearch_stats.h"
+
+// imagesearch2 with a color distance in place of the variation. Every opaque pixel of the needle must be
+// within the distance of the pixel under it. Compares 4 pixels at once, for both the focused pixel and each row.
+#include "distance.h"
+
+unsigned int * imagesearch5(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y, unsigned int metric, float distance, struct imagesearch_stats * stats) {
+    // source: left, top, width, height, stride, start, current refer to the haystack (main image)
+    // target: x, y, w, h, pitch, s, c refer to the needle (search or template image)
+    // Strides are in bytes so that either image can be a view into a larger parent buffer.
+
+    if (w > width || h > height)
+        return 0;
+
+    stride /= 4;                                    // Convert to pixels for pointer arithmetic
+    pitch /= 4;
+
+    int blind = (*((unsigned char *) (s + x + y * pitch) + 3) == 0);
+    struct space focus = to_space(metric, _mm_set1_epi32(*(s + x + y * pitch))); // Focused pixel
+    float limit = distance * distance;
+    __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+    unsigned int * found = 0;
+    unsigned int top, left, anchors = 0;
+
+    // Runs of one color are common, so four pixels equal to the last four reuse their result.
+    __m128i previous = _mm_set1_epi32(*(s + x + y * pitch));
+    int matches = 15;
+
+    // Likewise for the last four pixels of the needle and the haystack compared in full.
+    __m128i pair_c = _mm_setzero_si128(), pair_p = _mm_setzero_si128();
+    int pair = 15;
+
+    for (top = 0; top <= height - h; top++) {
+        unsigned int * row = start + top * stride;
+
+        for (left = 0; left <= width - w; left += 4) {
+            unsigned int * current = row + left;
+            unsigned int * f = current + x + y * stride;
+
+            // The focused pixel is checked at four positions at once, or fewer at the end of the row.
+            int last = width - w - left < 3 ? width - w - left : 3;
+            int mask = (2 << last) - 1;
+            if (!blind) {
+                __m128i vf = last == 3 ? _mm_loadu_si128((__m128i *) f) : _mm_setr_epi32(f[0], f[last > 0], f[last > 1 ? 2 : 0], 0);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(vf, previous)) != 0xFFFF)
+                    previous = vf, matches = near(metric, limit, to_space(metric, vf), focus);
+                mask &= matches;
+            }
+
+            for (; mask; mask &= mask - 1) {
+                unsigned int * position = current + __builtin_ctz(mask);
+                anchors++;
+
+                // Subimage matching loop, 4 pixels at a time. Transparent pixels of the needle always match.
+                for (unsigned int i = 0; i < h; i++) {
+                    unsigned int * c = s + i * pitch;
+                    unsigned int * p = position + i * stride;
+                    unsigned int j = 0;
+                    for (; j + 4 <= w; j += 4) {
+                        __m128i vc = _mm_loadu_si128((__m128i *) (c + j));
+                        __m128i vp = _mm_loadu_si128((__m128i *) (p + j));
+                        int opaque = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(vc, alpha), _mm_setzero_si128()))) ^ 15;
+                        if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi32(vc, pair_c), _mm_cmpeq_epi32(vp, pair_p))) != 0xFFFF)
+                            pair_c = vc, pair_p = vp, pair = near(metric, limit, to_space(metric, vc), to_space(metric, vp));
+                        if (opaque & ~pair)
+                            goto reject;
+                    }
+                    for (; j < w; j++)
+                        if (*((unsigned char *) (c + j) + 3))
+                            if (!(near(metric, limit, to_space(metric, _mm_cvtsi32_si128(c[j])), to_space(metric, _mm_cvtsi32_si128(p[j]))) & 1))
+                                goto reject;
+                    continue;
+
+                    reject:
+                    if (stats)
+                        stats->rejections[i < 15 ? i : 15]++;
+                    goto next;
+                }
+                found = position;
+                left = position - row;
+                goto done;
+
+                next:;
+            }
+        }
+    }
+
+    done:
+    if (stats) {
+        // The focused pixel is the only anchor, so every anchor is verified.
+        stats->positions += found ? top * (width - w + 1) + left + 1 : (height - h + 1) * (width - w + 1);
+        stats->anchors += anchors;
+        stats->verifications += anchors;
+        stats->results += (found != 0);
+    }
+
+    return found; // Null if not found
+}
@@ -0,0 +1,12 @@
+// Counters shared by the image searches that report how their anchors performed.
+#ifndef IMAGESEARCH_STATS
+#define IMAGESEARCH_STATS
+// Counters for one search, written only when the caller passes a stats pointer.
+struct imagesearch_stats {
+    unsigned int positions;      // Haystack positions visited
+    unsigned int anchors;        // Positions whose focused pixel matched
+    unsigned int verifications;  // Positions that passed every anchor and were compared in full
+    unsigned int results;        // Matches found
+    unsigned int rejections[16]; // Verifications that failed on needle row i. The last row counts rows 15 and up.
+};
+#endif
@@ -1,55 +1,48 @@
-unsigned int imagesearchall1(unsigned int ** result, unsigned int capacity, unsigned int * start, unsigned int width, unsigned int height, unsigned int * s, unsigned int w, unsigned int h) {
-    // width, height, start, current, end refer to the haystack (main image)
-    // x, y, w, h, s, c, e refer to the needle (search image)
+unsigned int imagesearchall1(unsigned int ** result, unsigned int capacity, unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y) {
+    // width, height, stride, start, current refer to the haystack (main image)
+    // x, y, w, h, pitch, s, c refer to the needle (search image)
+    // Strides are in bytes so that either image can be a view into a larger parent buffer.
     unsigned int count = 0;
-    unsigned int * current = start;
-    unsigned int * end = start + width * (height - h); // Remaining area must be greater than search height
-
-    int range_x = width - w;
-    int range_y = height - h; // optimized away
-
-    int x, y, offset;
-    unsigned int * c;
-    unsigned int * e;
-    unsigned int * p;
-
-    // Start off searching with pointers.
-    while (current < end) {
-
-        // Check if the current pixel matches the first pixel of subimage.
-        if (*current == *s || *((unsigned char *) s + 3) == 0) { // just continue if search image is transparent
-
-            // Convert current pointer to (x, y).
-            offset = current - start;
-            x = offset % width;
-            y = offset / width; // optimized away
-
-            // Check if (x, y) exceeds bounds.
-            if (x > range_x) // range_y check is done above
-                goto next;
-
-            // Subimage loop.
-            c = s;
-            for (int i = 0; i < h; i++) {
-                p = current + width * i;
-                e = c + w;
-                while (c < e) {
-                    if (*((unsigned char *) c + 3)) { // skip transparent pixels in search image
-                        if (*c != *p)
-                            goto next;
+
+    if (w > width || h > height)
+        return 0;
+
+    stride /= 4;                                    // Convert to pixels for pointer arithmetic
+    pitch /= 4;
+
+    int trans = (*((unsigned char *) s + 3) == 0);  // just continue if search image is transparent
+    int blind = (*((unsigned char *) (s + x + y * pitch) + 3) == 0);
+    unsigned int c1 = *(s);                         // Top-left pixel
+    unsigned int c4 = *(s + x + y * pitch);         // Focused pixel
+
+    for (unsigned int top = 0; top <= height - h; top++) {
+        unsigned int * row = start + top * stride;
+
+        for (unsigned int left = 0; left <= width - w; left++) {
+            unsigned int * current = row + left;
+
+            if (blind || c4 == *(current + x + y * stride))
+            if (trans || c1 == *(current))
+            {
+                // Subimage loop.
+                for (unsigned int i = 0; i < h; i++) {
+                    unsigned int * c = s + i * pitch;
+                    unsigned int * p = current + i * stride;
+                    for (unsigned int j = 0; j < w; j++) {
+                        if (*((unsigned char *) (c + j) + 3)) // skip transparent pixels in search image
+                            if (c[j] != p[j])
+                                goto next;
                     }
-                    c++; // Here simply incrementing will interate the entire image
-                    p++; // Will be reset each run
                 }
+
+                // Found matching image!
+                if (count < capacity)
+                    *(result + count) = current;
+                count++;
             }
-                
-            // Found matching image!
-            if (count < capacity)
-                *(result + count) = current;
-            count++;
+
+            next:;
         }
-        next:
-        current++;
     }
     return count;
-}
\ No newline at end of file
+}
@@ -0,0 +1,65 @@
+// Finds every match of a needle, switching to a 2D rolling hash when the anchors stop rejecting
+// positions and the needle has no transparent pixels. See imagesearch4.c.
+// The caller provides width - w + 1 unsigned integers of scratch for the column hashes.
+
+#include "rolling_hash.h"
+
+unsigned int imagesearchall4(unsigned int ** result, unsigned int capacity, unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y, unsigned int * columns) {
+    // width, height, stride, start, current refer to the haystack (main image)
+    // x, y, w, h, pitch, s refer to the needle (search image)
+    // Strides are in bytes so that either image can be a view into a larger parent buffer.
+    unsigned int count = 0;
+
+    if (w > width || h > height)
+        return 0;
+
+    stride /= 4;                                    // Convert to pixels for pointer arithmetic
+    pitch /= 4;
+
+    int trans = (*((unsigned char *) s + 3) == 0);  // just continue if search image is transparent
+    int blind = (*((unsigned char *) (s + x + y * pitch) + 3) == 0);
+    unsigned int c1 = *(s);                         // Top-left pixel
+    unsigned int c4 = *(s + x + y * pitch);         // Focused pixel
+
+    unsigned int n = width - w + 1;                 // Positions per row
+    unsigned int work = 0;                          // Pixels compared after the anchors matched
+    int hashable = opaque(s, w, h, pitch), hashing = 0;
+
+    unsigned int bw = power(ROW_BASE, w - 1);       // Weight of the pixel leaving a row
+    unsigned int ch = power(COLUMN_BASE, h - 1);    // Weight of the row leaving a column
+    unsigned int target = needle_hash(s, w, h, pitch);
+
+    for (unsigned int top = 0; top <= height - h; top++) {
+        unsigned int * row = start + top * stride;
+
+        for (unsigned int left = 0; left < n; left++) {
+            unsigned int * current = row + left;
+            unsigned int compared;
+
+            if (hashing ? columns[left] != target
+                        : (!blind && c4 != *(current + x + y * stride)) || (!trans && c1 != *(current)))
+                continue;
+
+            if ((compared = differ(current, stride, s, w, h, pitch)))
+                work += compared;
+            else {
+                if (count < capacity)
+                    *(result + count) = current;
+                count++;
+            }
+        }
+
+        if (top == height - h)
+            break;
+
+        // Switch when the comparisons average more than 4 pixels per position.
+        if (hashing)
+            next_row(columns, row, width, stride, w, h, bw, ch);
+        else if (hashable && work / 4 > n * (top + 1)) {
+            hashing = 1;
+            first_rows(columns, row + stride, width, stride, w, h, bw);
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,145 @@
+// Summed-area tables of 32-bit ARGB, for the mean and variance of any rectangle from four entries.
+// Entry (x, y) of a table holds the sums of B, G, R, and A over the pixels above and to the left of it, so the
+// tables are (width + 1) × (height + 1) entries with a first row and column of zeros. Sums and sums of squares
+// are 64-bit, so they cannot overflow for any image.
+// Pass 1 sums the rows [first, last) into a table of their own, as if the rows above were zeros, and pass 2
+// adds the last row of each of these bands to the rows of the bands below, over the columns [first, last).
+// A single band needs no pass 2, and reads the row above it while it is still in the cache. Both passes can be
+// split across threads. Pass 3 answers the rectangles [first, last).
+#include <emmintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+
+struct integral {
+    unsigned int * pixels;          // Source pixels (ARGB)
+    unsigned long long * sums;      // 4 sums per entry, B, G, R, A
+    unsigned long long * squares;   // 4 sums of squares per entry, or null to skip variances
+    int * rects;                    // x, y, w, h of each rectangle for pass 3
+    double * results;               // Means of B, G, R, A then their variances, 8 per rectangle
+    unsigned int width, height, stride; // Source dimensions, stride in bytes
+    unsigned int bands;             // Number of equal bands of rows in pass 1, band i starting at i × height / bands
+    unsigned int pass;              // 1 = rows, 2 = columns, 3 = rectangles
+    unsigned int first, last;       // Rows, columns, or rectangles of this thread
+};
+
+static void sum_rows(struct integral * r) {
+    size_t pitch = 2 * ((size_t) r->width + 1);
+    __m128i zero = _mm_setzero_si128();
+
+    // The first row of the tables is all zeros.
+    if (r->first == 0)
+        for (size_t i = 0; i < pitch; i++) {
+            ((__m128i *) r->sums)[i] = zero;
+            if (r->squares)
+                ((__m128i *) r->squares)[i] = zero;
+        }
+
+    for (unsigned int y = r->first; y < r->last; y++) {
+        unsigned int * row = (unsigned int *) ((unsigned char *) r->pixels + (size_t) y * r->stride);
+        __m128i * sums = (__m128i *) r->sums + (y + 1) * pitch;
+        __m128i * squares = (__m128i *) r->squares + (y + 1) * pitch;
+        __m128i bg = zero, ra = zero, bg2 = zero, ra2 = zero;
+
+        // The first row of a band has nothing above it.
+        size_t above = (y > r->first) ? pitch : 0;
+
+        sums[0] = sums[1] = zero;
+        if (r->squares)
+            squares[0] = squares[1] = zero;
+
+        for (unsigned int x = 0; x < r->width; x++) {
+            // Widen the channels to 16 bits, where their squares still fit, then to 64 bits.
+            __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(row[x]), zero);
+            __m128i c32 = _mm_unpacklo_epi16(c, zero);
+            bg = _mm_add_epi64(bg, _mm_unpacklo_epi32(c32, zero));
+            ra = _mm_add_epi64(ra, _mm_unpackhi_epi32(c32, zero));
+            sums[2 * x + 2] = above ? _mm_add_epi64(bg, sums[2 * x + 2 - above]) : bg;
+            sums[2 * x + 3] = above ? _mm_add_epi64(ra, sums[2 * x + 3 - above]) : ra;
+
+            if (r->squares) {
+                __m128i s32 = _mm_unpacklo_epi16(_mm_mullo_epi16(c, c), zero);
+                bg2 = _mm_add_epi64(bg2, _mm_unpacklo_epi32(s32, zero));
+                ra2 = _mm_add_epi64(ra2, _mm_unpackhi_epi32(s32, zero));
+                squares[2 * x + 2] = above ? _mm_add_epi64(bg2, squares[2 * x + 2 - above]) : bg2;
+                squares[2 * x + 3] = above ? _mm_add_epi64(ra2, squares[2 * x + 3 - above]) : ra2;
+            }
+        }
+    }
+}
+
+static void add_row(__m128i * row, __m128i * carry, unsigned int first, unsigned int last) {
+    for (unsigned int i = 2 * first; i < 2 * last; i++)
+        row[i] = _mm_add_epi64(row[i], carry[i]);
+}
+
+static void sum_bands(struct integral * r) {
+    // Each entry holds 4 sums, so the columns [first, last) are a run of 2 vectors per entry in every row.
+    // The bands are done in order, so the last row of the band above is final by the time it is carried.
+    size_t pitch = 2 * ((size_t) r->width + 1);
+
+    for (unsigned int band = 1; band < r->bands; band++) {
+        unsigned int top = band * r->height / r->bands, bottom = (band + 1) * r->height / r->bands;
+        for (unsigned int y = top + 1; y <= bottom; y++) {
+            add_row((__m128i *) r->sums + y * pitch, (__m128i *) r->sums + top * pitch, r->first, r->last);
+            if (r->squares)
+                add_row((__m128i *) r->squares + y * pitch, (__m128i *) r->squares + top * pitch, r->first, r->last);
+        }
+    }
+}
+
+// The 4 sums of a rectangle from the entries at its corners. The tables wrap around as unsigned integers,
+// which the differences undo.
+static void corners(unsigned long long * table, size_t columns, int x1, int y1, int x2, int y2, unsigned long long * out) {
+    __m128i * a = (__m128i *) (table + 4 * (y1 * columns + x1));
+    __m128i * b = (__m128i *) (table + 4 * (y1 * columns + x2));
+    __m128i * c = (__m128i *) (table + 4 * (y2 * columns + x1));
+    __m128i * d = (__m128i *) (table + 4 * (y2 * columns + x2));
+    _mm_storeu_si128((__m128i *) out, _mm_add_epi64(_mm_sub_epi64(d[0], _mm_add_epi64(b[0], c[0])), a[0]));
+    _mm_storeu_si128((__m128i *) out + 1, _mm_add_epi64(_mm_sub_epi64(d[1], _mm_add_epi64(b[1], c[1])), a[1]));
+}
+
+static void rectangles(struct integral * r) {
+    size_t columns = (size_t) r->width + 1;
+    unsigned long long sums[4], squares[4];
+
+    for (unsigned int i = r->first; i < r->last; i++) {
+        int * rect = r->rects + 4 * i;
+        double * out = r->results + 8 * i;
+
+        // Clip the rectangle to the image. Empty rectangles have a mean and variance of zero.
+        int x1 = rect[0] < 0 ? 0 : rect[0], y1 = rect[1] < 0 ? 0 : rect[1];
+        int x2 = rect[0] + rect[2], y2 = rect[1] + rect[3];
+        x2 = x2 > (int) r->width ? (int) r->width : x2;
+        y2 = y2 > (int) r->height ? (int) r->height : y2;
+        for (int k = 0; k < 8; k++)
+            out[k] = 0;
+        if (x1 >= x2 || y1 >= y2)
+            continue;
+
+        double n = (double) (x2 - x1) * (y2 - y1);
+        corners(r->sums, columns, x1, y1, x2, y2, sums);
+        for (int k = 0; k < 4; k++)
+            out[k] = (long long) sums[k] / n; // Signed, since 32-bit code has no unsigned conversion.
+
+        if (r->squares) {
+            corners(r->squares, columns, x1, y1, x2, y2, squares);
+            for (int k = 0; k < 4; k++) {
+                double variance = (long long) squares[k] / n - out[k] * out[k];
+                out[k + 4] = variance > 0 ? variance : 0;
+            }
+        }
+    }
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int integral(struct integral * r) {
+    if (r->pass == 1)
+        sum_rows(r);
+    if (r->pass == 2)
+        sum_bands(r);
+    if (r->pass == 3)
+        rectangles(r);
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Copies a rectangle of 32-bit ARGB to and from packed arrays of its channels, as bytes or as float32.
+// Channels are chosen and ordered by order, so RGB, BGRA, or a single A can be packed. Arrays are interleaved
+// (HWC, the channels of each pixel together) or planar (CHW, a plane of each channel, one after another).
+// Floats are channel × scale + bias when packed. When unpacked, they are rounded to the nearest integer after
+// the same transform, so the caller passes the inverse, and are clamped to 0 to 255. Unpacking leaves the
+// channels that are not in the array as they were.
+// Pass 0 packs and pass 1 unpacks the rows [first, last), so each can be split across threads.
+#include <emmintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+
+struct pack {
+    unsigned int * pixels;          // Top left pixel of the rectangle (ARGB)
+    void * data;                    // Packed bytes or floats
+    float scale[4], bias[4];        // Transform of each channel of a float array
+    unsigned int width, height, stride; // Rectangle dimensions, stride in bytes
+    unsigned int channels;          // 1 to 4
+    unsigned char order[4];         // Channel of each array entry, 0 = B, 1 = G, 2 = R, 3 = A
+    unsigned int planar;            // 0 = HWC, 1 = CHW
+    unsigned int floats;            // 0 = bytes, 1 = float32
+    unsigned int pass;              // 0 = pack, 1 = unpack
+    unsigned int first, last;       // Rows of this thread
+};
+
+static int round_clamp(float f) {
+    int v = _mm_cvtss_si32(_mm_set_ss(f));
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Packs or unpacks the entries [c, channels) of pixels [x, width) of row y, one pixel at a time.
+static void entries(struct pack * r, unsigned int * row, unsigned int y, unsigned int x, unsigned int c, unsigned int channels) {
+    // Entry c of pixel x is at base + c × step.
+    size_t step = r->planar ? (size_t) r->width * r->height : 1;
+    size_t base = r->planar ? (size_t) y * r->width + x : ((size_t) y * r->width + x) * r->channels;
+    size_t advance = r->planar ? 1 : r->channels;
+    unsigned char * bytes = (unsigned char *) r->data + base;
+    float * floats = (float *) r->data + base;
+
+    for (; x < r->width; x++, bytes += advance, floats += advance) {
+        unsigned int p = row[x];
+        for (unsigned int k = c; k < channels; k++) {
+            unsigned int shift = 8 * r->order[k];
+            if (r->pass == 0) {
+                unsigned int v = p >> shift & 0xFF;
+                if (r->floats)
+                    floats[k * step] = v * r->scale[k] + r->bias[k];
+                else
+                    bytes[k * step] = v;
+            }
+            else {
+                unsigned int v = r->floats ? round_clamp(floats[k * step] * r->scale[k] + r->bias[k]) : bytes[k * step];
+                p = (p & ~(0xFFu << shift)) | v << shift;
+            }
+        }
+        // Packing only reads, so the pixels may be read-only or still being written by another thread.
+        if (r->pass == 1)
+            row[x] = p;
+    }
+}
+
+// Planes are contiguous in both the image and the array, so they are converted four pixels at a time.
+static void planes(struct pack * r, unsigned int * row, unsigned int y, unsigned int c) {
+    __m128i shift = _mm_cvtsi32_si128(8 * r->order[c]);
+    __m128i mask = _mm_sll_epi32(_mm_set1_epi32(0xFF), shift);
+    __m128 scale = _mm_set1_ps(r->scale[c]), bias = _mm_set1_ps(r->bias[c]);
+    size_t start = c * (size_t) r->width * r->height + (size_t) y * r->width;
+    unsigned char * bytes = (unsigned char *) r->data + start;
+    float * floats = (float *) r->data + start;
+    unsigned int x = 0;
+
+    for (; x + 4 <= r->width; x += 4) {
+        __m128i p = _mm_loadu_si128((__m128i *) (row + x));
+        if (r->pass == 0) {
+            __m128i v = _mm_srl_epi32(_mm_and_si128(p, mask), shift);
+            if (r->floats)
+                _mm_storeu_ps(floats + x, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), scale), bias));
+            else {
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                *(unsigned int *) (bytes + x) = _mm_cvtsi128_si32(v);
+            }
+        }
+        else {
+            __m128i v;
+            if (r->floats) {
+                // Saturating packs clamp to 0 to 255.
+                v = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(floats + x), scale), bias));
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+            }
+            else
+                v = _mm_cvtsi32_si128(*(unsigned int *) (bytes + x));
+            v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, _mm_setzero_si128()), _mm_setzero_si128());
+            p = _mm_or_si128(_mm_andnot_si128(mask, p), _mm_sll_epi32(v, shift));
+            _mm_storeu_si128((__m128i *) (row + x), p);
+        }
+    }
+
+    entries(r, row, y, x, c, c + 1);
+}
+
+// Interleaved bytes move as one 32-bit word per pixel, with the entries in its low bytes. Each word spills into
+// the pixels after it, so the last few pixels of each row are left to entries() and no word reaches into the row
+// of another thread.
+static unsigned int words(struct pack * r, unsigned int * row, unsigned int y) {
+    unsigned char * bytes = (unsigned char *) r->data + (size_t) y * r->width * r->channels;
+    __m128i ff = _mm_set1_epi32(0xFF), keep = _mm_set1_epi32(-1);
+    unsigned int x = 0;
+
+    for (unsigned int k = 0; k < r->channels; k++)
+        keep = _mm_andnot_si128(_mm_sll_epi32(ff, _mm_cvtsi32_si128(8 * r->order[k])), keep);
+
+    for (; (x + 3) * r->channels + 4 <= r->width * r->channels; x += 4, bytes += 4 * r->channels) {
+        __m128i p = _mm_loadu_si128((__m128i *) (row + x)), q = _mm_setzero_si128();
+        if (r->pass == 0) {
+            for (unsigned int k = 0; k < r->channels; k++) {
+                __m128i v = _mm_and_si128(_mm_srl_epi32(p, _mm_cvtsi32_si128(8 * r->order[k])), ff);
+                q = _mm_or_si128(q, _mm_sll_epi32(v, _mm_cvtsi32_si128(8 * k)));
+            }
+            for (unsigned int i = 0; i < 4; i++, q = _mm_srli_si128(q, 4))
+                *(unsigned int *) (bytes + i * r->channels) = _mm_cvtsi128_si32(q);
+        }
+        else {
+            q = _mm_setr_epi32(*(int *) bytes, *(int *) (bytes + r->channels), *(int *) (bytes + 2 * r->channels), *(int *) (bytes + 3 * r->channels));
+            p = _mm_and_si128(p, keep);
+            for (unsigned int k = 0; k < r->channels; k++) {
+                __m128i v = _mm_and_si128(_mm_srl_epi32(q, _mm_cvtsi32_si128(8 * k)), ff);
+                p = _mm_or_si128(p, _mm_sll_epi32(v, _mm_cvtsi32_si128(8 * r->order[k])));
+            }
+            _mm_storeu_si128((__m128i *) (row + x), p);
+        }
+    }
+    return x;
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int pack(struct pack * r) {
+    for (unsigned int y = r->first; y < r->last; y++) {
+        unsigned int * row = (unsigned int *) ((unsigned char *) r->pixels + (size_t) y * r->stride);
+        if (r->planar)
+            for (unsigned int c = 0; c < r->channels; c++)
+                planes(r, row, y, c);
+        else
+            entries(r, row, y, r->floats ? 0 : words(r, row, y), 0, r->channels);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Maps every pixel to its position in a palette of at most 255 colors, one byte per pixel.
+// plane is packed, width bytes per row. colors holds the palette and count is how many it has so far.
+// table is 512 unsigned ints that hash each color to its index + 1. Zero it before the first call and keep it,
+// along with colors, to map more images onto the same palette.
+// When needle is nonzero no colors are added: transparent pixels become 255 and any other color missing from
+// the palette fails, since the needle cannot appear in the haystack.
+// Returns the number of colors in the palette, or 256 on failure.
+
+#define PALETTE_SLOTS 512
+
+unsigned int palette(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned char * plane, unsigned int * colors, unsigned int * table, unsigned int count, unsigned int needle) {
+
+    stride /= 4;
+
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned int * row = start + y * stride;
+        unsigned int previous = 0;
+        unsigned char index = 255;
+
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int c = row[x];
+
+            // Runs of one color are common in screenshots and skip the hash entirely.
+            if (c != previous || index == 255) {
+                if (needle && (c >> 24) == 0)
+                    index = 255;
+
+                else {
+                    // Fibonacci hashing spreads nearby colors across the table. Probe linearly.
+                    unsigned int slot = (c * 0x9E3779B1u) >> 23;
+                    while (table[slot] && colors[table[slot] - 1] != c)
+                        slot = (slot + 1) % PALETTE_SLOTS;
+
+                    if (table[slot] == 0) {
+                        if (needle || count == 255)
+                            return 256;
+                        colors[count++] = c;
+                        table[slot] = count;
+                    }
+                    index = table[slot] - 1;
+                }
+                previous = c;
+            }
+
+            plane[y * width + x] = index;
+        }
+    }
+
+    return count;
+}
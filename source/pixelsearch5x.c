@@ -0,0 +1,39 @@
+// Searches for a color within a distance instead of a box of variations. Uses 128-bit registers and compares
+// 4 pixels at once. See the metrics below.
+#include "distance.h"
+
+unsigned int * pixelsearch5x(unsigned int * start, unsigned int * end, unsigned int color, unsigned int metric, float distance) {
+
+    // Convert the target color once.
+    struct space target = to_space(metric, _mm_set1_epi32(color));
+    float limit = distance * distance;
+
+    // Runs of one color are common, so four pixels equal to the last four reuse their result.
+    __m128i previous = _mm_set1_epi32(color);
+    int mask = 15;
+
+    // Loop over start pointer with a step of four unsigned integers.
+    while (start < end - 3) {
+
+        // Convert four pixels and compare each of them to the target color.
+        __m128i vstart = _mm_loadu_si128((__m128i *) start);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(vstart, previous)) != 0xFFFF)
+            previous = vstart, mask = near(metric, limit, to_space(metric, vstart), target);
+
+        // If the mask is nonzero, there is at least one match.
+        if (mask != 0)
+            break;
+
+        // Increment start by four unsigned integers.
+        start += 4;
+    }
+
+    // Clean up any remaining elements. The same vector code is used so the result does not depend on alignment.
+    while (start < end) {
+        if (near(metric, limit, to_space(metric, _mm_cvtsi32_si128(*start)), target) & 1)
+            return start;
+        start++;
+    }
+
+    return start; // start == end if no match.
+}
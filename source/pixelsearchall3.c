@@ -6,6 +6,7 @@ unsigned int pixelsearchall3(unsigned int ** result, unsigned int limit, unsigne
                 if (count < limit)
                     *(result + count) = start;
                 count++;
+                break; // Count each pixel once.
             }
         start++;
     }
@@ -20,6 +20,7 @@ unsigned int pixelsearchall4(unsigned int ** result, unsigned int limit, unsigne
                 if (count < limit)
                     *(result + count) = start;
                 count++;
+                break; // Count each pixel once.
             }
         }
         start++;
@@ -0,0 +1,46 @@
+// Finds every pixel within a distance of a color. Uses 128-bit registers and compares 4 pixels at once.
+// Returns the number of matches, which may be more than the limit. Only the first limit addresses are written.
+#include "distance.h"
+
+unsigned int pixelsearchall5x(unsigned int ** result, unsigned int limit, unsigned int * start, unsigned int * end, unsigned int color, unsigned int metric, float distance) {
+
+    // Track number of matching searches.
+    unsigned int count = 0;
+
+    // Convert the target color once.
+    struct space target = to_space(metric, _mm_set1_epi32(color));
+    float within = distance * distance;
+
+    // Runs of one color are common, so four pixels equal to the last four reuse their result.
+    __m128i previous = _mm_set1_epi32(color);
+    int matches = 15;
+
+    // Loop over start pointer with a step of four unsigned integers.
+    while (start < end - 3) {
+        __m128i vstart = _mm_loadu_si128((__m128i *) start);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(vstart, previous)) != 0xFFFF)
+            previous = vstart, matches = near(metric, within, to_space(metric, vstart), target);
+
+        // Record the matches in order.
+        for (int mask = matches; mask; mask &= mask - 1) {
+            if (count < limit)
+                result[count] = start + __builtin_ctz(mask);
+            count++;
+        }
+
+        // Increment start by four unsigned integers.
+        start += 4;
+    }
+
+    // Clean up any remaining elements.
+    while (start < end) {
+        if (near(metric, within, to_space(metric, _mm_cvtsi32_si128(*start)), target) & 1) {
+            if (count < limit)
+                result[count] = start;
+            count++;
+        }
+        start++;
+    }
+
+    return count;
+}
@@ -0,0 +1,614 @@
+// PNG encoder for 32-bit ARGB. Replaces the GDI+ PNG encoder in BitmapToStream.
+// Pass 0 builds the CRC table and chooses RGB when every pixel is opaque, otherwise RGBA.
+// Pass 1 encodes the rows [first, last) as one IDAT chunk: each row is converted, filtered with
+// whichever of none, sub, up, or paeth has the smallest sum of absolute differences, and deflated.
+// Bands are independent deflate blocks that end on a byte boundary, so they can be encoded on
+// separate threads and written one after another. The caller appends the combined Adler-32.
+#include <emmintrin.h>
+
+struct png {
+    unsigned char * pixels;     // Source pixels (ARGB)
+    unsigned char * filtered;   // height × (1 + bpp × width) bytes of filtered rows
+    unsigned char * out;        // IDAT chunk of this band
+    unsigned int * crc;         // 8 × 256 table for CRC-32, filled by pass 0
+    unsigned char * work;       // Scratch of this band, SCRATCH + 6 × (4 × width + 48) bytes
+    unsigned int width, height, stride; // Source dimensions, stride in bytes
+    unsigned int bpp;           // 3 = RGB, 4 = RGBA, chosen by pass 0
+    unsigned int level;         // 0 = store, 1 = fastest (run length), 2 = fast, 3 = small
+    unsigned int pass;          // 0 = setup, 1 = encode
+    unsigned int first, last;   // Rows of this band
+    unsigned int size;          // Bytes written to out
+    unsigned int adler;         // Adler-32 of the filtered rows of this band
+};
+
+#define SYMBOLS 16384           // Symbols per deflate block
+#define HASH_BITS 15
+#define WINDOW 32768
+#define SCRATCH 0x54000         // Hash tables, symbols, and Huffman nodes. Rows follow.
+
+// Deflate lengths 3..258 and distances 1..32768 as base values and extra bits.
+static const unsigned short length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char cl_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+struct bits {
+    unsigned char * p;
+    unsigned long long buffer;
+    unsigned int count;
+};
+
+static inline void put(struct bits * b, unsigned int value, unsigned int n) {
+    b->buffer |= (unsigned long long) value << b->count;
+    b->count += n;
+    while (b->count >= 8) {
+        *b->p++ = (unsigned char) b->buffer;
+        b->buffer >>= 8;
+        b->count -= 8;
+    }
+}
+
+static void align(struct bits * b) {
+    if (b->count)
+        put(b, 0, 8 - b->count);
+}
+
+static unsigned int reverse(unsigned int code, unsigned int n) {
+    unsigned int r = 0;
+    while (n--)
+        r = r << 1 | (code & 1), code >>= 1;
+    return r;
+}
+
+// Huffman code lengths limited to limit bits. Symbols with a frequency of 0 get no code.
+// Large arrays live in tmp, because Windows only grows a thread stack one page at a time.
+static void huffman(const unsigned int * freq, int n, int limit, unsigned char * lengths, int * tmp) {
+    int * sym = tmp, * parent = tmp + 288, * depth = tmp + 288 + 576, count = 0;
+    unsigned int * weight = (unsigned int *) (tmp + 288 + 2 * 576);
+
+    for (int i = 0; i < n; i++) {
+        lengths[i] = 0;
+        if (freq[i])
+            sym[count++] = i;
+    }
+    // Decoders need at least two codes.
+    for (int i = 0; count < 2; i++)
+        if (!freq[i])
+            sym[count++] = i;
+
+    // Sort the symbols by frequency, treating unused symbols as 1.
+    for (int i = 1; i < count; i++) {
+        int s = sym[i], j = i;
+        unsigned int f = freq[s] ? freq[s] : 1;
+        for (; j > 0 && (freq[sym[j - 1]] ? freq[sym[j - 1]] : 1) > f; j--)
+            sym[j] = sym[j - 1];
+        sym[j] = s;
+    }
+
+    // Merge the two lightest nodes with a queue of leaves and a queue of internal nodes.
+    for (int i = 0; i < count; i++)
+        weight[i] = freq[sym[i]] ? freq[sym[i]] : 1;
+    int leaf = 0, node = count, next = count;
+    for (; next < 2 * count - 1; next++) {
+        int pick[2];
+        for (int k = 0; k < 2; k++)
+            pick[k] = (leaf < count && (node >= next || weight[leaf] <= weight[node])) ? leaf++ : node++;
+        weight[next] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = next;
+    }
+
+    // Depths from the root, which is the last node.
+    int bl_count[64] = {0};
+    depth[2 * count - 2] = 0;
+    for (int i = 2 * count - 3; i >= 0; i--)
+        depth[i] = depth[parent[i]] + 1;
+    for (int i = 0; i < count; i++)
+        bl_count[depth[i] < 63 ? depth[i] : 63]++;
+
+    // Move codes that are too long up to the limit and rebalance so the code stays complete.
+    for (int i = limit + 1; i < 64; i++)
+        bl_count[limit] += bl_count[i], bl_count[i] = 0;
+    unsigned int total = 0;
+    for (int i = 1; i <= limit; i++)
+        total += (unsigned int) bl_count[i] << (limit - i);
+    while (total > (1u << limit)) {
+        bl_count[limit]--;
+        for (int i = limit - 1; i > 0; i--)
+            if (bl_count[i]) {
+                bl_count[i]--;
+                bl_count[i + 1] += 2;
+                break;
+            }
+        total--;
+    }
+
+    // The least frequent symbols get the longest codes.
+    int k = 0;
+    for (int len = limit; len > 0; len--)
+        for (int j = 0; j < bl_count[len]; j++)
+            lengths[sym[k++]] = len;
+}
+
+// Canonical codes, bit reversed because deflate writes codes starting from the most significant bit.
+static void canonical(const unsigned char * lengths, int n, unsigned short * codes) {
+    unsigned int bl_count[16] = {0}, next[16];
+    for (int i = 0; i < n; i++)
+        bl_count[lengths[i]]++;
+    bl_count[0] = 0;
+    unsigned int code = 0;
+    for (int len = 1; len < 16; len++)
+        next[len] = code = (code + bl_count[len - 1]) << 1;
+    for (int i = 0; i < n; i++)
+        codes[i] = lengths[i] ? reverse(next[lengths[i]]++, lengths[i]) : 0;
+}
+
+struct block {
+    unsigned int * symbols;     // Literal, or 0x100 | length - 3 with the distance in bits 16-31
+    int * tmp;                  // Huffman nodes
+    unsigned int count;         // Number of symbols
+    unsigned int litfreq[286], distfreq[30];
+    unsigned int extra;         // Extra bits of every length and distance
+    unsigned char * lcode, * dcode; // Length - 3 to code, (distance - 1) to code for the first 512 and >> 8 above
+};
+
+static void lit(struct block * k, unsigned int c) {
+    k->symbols[k->count++] = c;
+    k->litfreq[c]++;
+}
+
+static void match(struct block * k, unsigned int len, unsigned int dist) {
+    unsigned int l = k->lcode[len - 3], d = (dist <= 512) ? k->dcode[dist - 1] : k->dcode[512 + ((dist - 1) >> 8)];
+    k->symbols[k->count++] = 0x100 | (len - 3) | dist << 16;
+    k->litfreq[257 + l]++;
+    k->distfreq[d]++;
+    k->extra += length_extra[l] + dist_extra[d];
+}
+
+static void stored(struct bits * b, const unsigned char * data, unsigned int size) {
+    do {
+        unsigned int n = size < 65535 ? size : 65535;
+        put(b, 0, 3);
+        align(b);
+        put(b, n, 16);
+        put(b, n ^ 0xFFFF, 16);
+        for (unsigned int i = 0; i < n; i++)
+            *b->p++ = data[i];
+        data += n;
+        size -= n;
+    } while (size);
+}
+
+// Writes the symbols of a block with whichever of dynamic Huffman, fixed Huffman, or stored is smallest.
+static void flush(struct bits * b, struct block * k, const unsigned char * data, unsigned int size) {
+    unsigned char ll[288] = {0}, dl[30], fl[288], fdl[30], cll[19];
+    unsigned short lc[288], dc[30], clc[19];
+    unsigned int clfreq[19] = {0}, * rle = (unsigned int *) (k->tmp + 288 + 4 * 576), nrle = 0;
+
+    if (size == 0)
+        return;
+    k->litfreq[256] = 1; // End of block
+
+    huffman(k->litfreq, 286, 15, ll, k->tmp);
+    huffman(k->distfreq, 30, 15, dl, k->tmp);
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && !ll[hlit - 1]) hlit--;
+    while (hdist > 1 && !dl[hdist - 1]) hdist--;
+
+    // Run length encode the code lengths with 16 (repeat previous), 17 and 18 (repeat zero).
+    unsigned char all[286 + 30];
+    int total = hlit + hdist;
+    for (int i = 0; i < hlit; i++) all[i] = ll[i];
+    for (int i = 0; i < hdist; i++) all[hlit + i] = dl[i];
+    for (int i = 0; i < total;) {
+        int run = 1;
+        while (i + run < total && all[i + run] == all[i]) run++;
+        if (all[i] == 0 && run >= 3) {
+            run = run > 138 ? 138 : run;
+            rle[nrle++] = (run >= 11) ? 18 | (run - 11) << 8 : 17 | (run - 3) << 8;
+            clfreq[run >= 11 ? 18 : 17]++;
+        }
+        else if (all[i] != 0 && run >= 4) {
+            rle[nrle++] = all[i];
+            clfreq[all[i]]++;
+            run = (run - 1 > 6) ? 7 : run;
+            rle[nrle++] = 16 | (run - 4) << 8;
+            clfreq[16]++;
+        }
+        else {
+            run = 1;
+            rle[nrle++] = all[i];
+            clfreq[all[i]]++;
+        }
+        i += run;
+    }
+    huffman(clfreq, 19, 7, cll, k->tmp);
+    int hclen = 19;
+    while (hclen > 4 && !cll[cl_order[hclen - 1]]) hclen--;
+
+    // Compare the sizes in bits.
+    unsigned long long dynamic = 3 + 14 + 3 * hclen + k->extra, fixed = 3 + k->extra;
+    for (int i = 0; i < 19; i++)
+        dynamic += clfreq[i] * (cll[i] + (i == 16 ? 2 : i == 17 ? 3 : i == 18 ? 7 : 0));
+    for (int i = 0; i < 288; i++)
+        fl[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    for (int i = 0; i < 286; i++) {
+        dynamic += (unsigned long long) k->litfreq[i] * ll[i];
+        fixed += (unsigned long long) k->litfreq[i] * fl[i];
+    }
+    for (int i = 0; i < 30; i++) {
+        fdl[i] = 5;
+        dynamic += (unsigned long long) k->distfreq[i] * dl[i];
+        fixed += (unsigned long long) k->distfreq[i] * 5;
+    }
+    unsigned long long store = 8 * (unsigned long long) size + 40 * (size / 65535 + 1) + 7;
+
+    if (store <= dynamic && store <= fixed) {
+        stored(b, data, size);
+        goto reset;
+    }
+
+    const unsigned char * L = ll, * D = dl;
+    if (fixed < dynamic) {
+        put(b, 1 << 1, 3);
+        L = fl, D = fdl;
+    }
+    else {
+        put(b, 2 << 1, 3);
+        put(b, hlit - 257, 5);
+        put(b, hdist - 1, 5);
+        put(b, hclen - 4, 4);
+        for (int i = 0; i < hclen; i++)
+            put(b, cll[cl_order[i]], 3);
+        canonical(cll, 19, clc);
+        for (unsigned int i = 0; i < nrle; i++) {
+            unsigned int s = rle[i] & 0xFF, e = rle[i] >> 8;
+            put(b, clc[s], cll[s]);
+            if (s == 16) put(b, e, 2);
+            if (s == 17) put(b, e, 3);
+            if (s == 18) put(b, e, 7);
+        }
+    }
+    canonical(L, 288, lc); // The fixed code counts symbols 286 and 287.
+    canonical(D, 30, dc);
+    for (unsigned int i = 0; i < k->count; i++) {
+        unsigned int s = k->symbols[i];
+        if (s < 0x100)
+            put(b, lc[s], L[s]);
+        else {
+            unsigned int len = (s & 0xFF) + 3, dist = s >> 16;
+            unsigned int l = k->lcode[len - 3], d = (dist <= 512) ? k->dcode[dist - 1] : k->dcode[512 + ((dist - 1) >> 8)];
+            put(b, lc[257 + l], L[257 + l]);
+            put(b, len - length_base[l], length_extra[l]);
+            put(b, dc[d], D[d]);
+            put(b, dist - dist_base[d], dist_extra[d]);
+        }
+    }
+    put(b, lc[256], L[256]);
+
+reset:
+    k->count = 0;
+    k->extra = 0;
+    for (int i = 0; i < 286; i++) k->litfreq[i] = 0;
+    for (int i = 0; i < 30; i++) k->distfreq[i] = 0;
+}
+
+static inline unsigned int load32(const unsigned char * p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+static inline unsigned int hash(const unsigned char * p) {
+    return (load32(p) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Length of the common prefix of a and b, up to max.
+static inline unsigned int common(const unsigned char * a, const unsigned char * b, unsigned int max) {
+    unsigned int n = 0;
+    while (n + 16 <= max) {
+        unsigned int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (a + n)), _mm_loadu_si128((__m128i *) (b + n))));
+        if (m != 0xFFFF)
+            return n + __builtin_ctz(~m);
+        n += 16;
+    }
+    while (n < max && a[n] == b[n])
+        n++;
+    return n;
+}
+
+static void deflate(struct png * r, struct bits * b, const unsigned char * data, unsigned int size) {
+    struct block k = {0};
+    int * head = (int *) r->work;                       // Latest position of each hash
+    int * prev = head + (1 << HASH_BITS);               // Previous position with the same hash
+    k.symbols = (unsigned int *) (prev + WINDOW);
+    k.tmp = (int *) (k.symbols + SYMBOLS);              // 288 + 4 × 576 + 316 entries
+    k.lcode = (unsigned char *) (k.tmp + 3200);         // 256 entries
+    k.dcode = k.lcode + 256;                            // 512 + 128 entries
+
+    if (r->level == 0) {
+        stored(b, data, size);
+        return;
+    }
+
+    for (int l = 0, n = 0; l < 29; l++)
+        for (int j = 0; j < 1 << length_extra[l] && n < 256; j++)
+            k.lcode[n++] = l;
+    k.lcode[255] = 28; // 258 has its own code
+    for (int d = 0; d < 30; d++)
+        for (unsigned int j = dist_base[d] - 1; j < dist_base[d] - 1u + (1u << dist_extra[d]); j++)
+            if (j < 512) k.dcode[j] = d;
+            else k.dcode[512 + (j >> 8)] = d;
+    for (int i = 0; i < 1 << HASH_BITS; i++)
+        head[i] = -1;
+
+    unsigned int start = 0, i = 0;
+    while (i < size) {
+        unsigned int max = (size - i < 258) ? size - i : 258, len = 0, dist = 0;
+
+        // Runs of the previous byte, which filtered images are full of.
+        if (i > 0 && max >= 3) {
+            len = common(data + i, data + i - 1, max);
+            dist = 1;
+        }
+
+        if (r->level >= 2 && max >= 4) {
+            unsigned int h = hash(data + i);
+            int candidate = head[h];
+            head[h] = i;
+            prev[i % WINDOW] = candidate;
+
+            // Follow the chain of earlier positions with the same hash.
+            for (int depth = (r->level == 3) ? 32 : 1; candidate >= 0 && i - candidate <= WINDOW && len < max && depth--; candidate = prev[candidate % WINDOW]) {
+                if (data[candidate + len] != data[i + len] || load32(data + candidate) != load32(data + i))
+                    continue;
+                unsigned int n = common(data + i, data + candidate, max);
+                if (n > len)
+                    len = n, dist = i - candidate;
+                if (n == max)
+                    break;
+            }
+        }
+
+        if (len < 3) {
+            lit(&k, data[i++]);
+        }
+        else {
+            match(&k, len, dist);
+            // The small preset inserts the positions inside the match so later data can refer to them.
+            unsigned int end = i + len;
+            while (r->level == 3 && ++i < end && i + 4 <= size) {
+                unsigned int h = hash(data + i);
+                prev[i % WINDOW] = head[h];
+                head[h] = i;
+            }
+            i = end;
+        }
+
+        if (k.count >= SYMBOLS - 1) {
+            flush(b, &k, data + start, i - start);
+            start = i;
+        }
+    }
+    flush(b, &k, data + start, size - start);
+}
+
+static unsigned int adler32(const unsigned char * data, unsigned int size) {
+    unsigned int a = 1, b = 0;
+    while (size) {
+        unsigned int n = size < 5552 ? size : 5552;
+        size -= n;
+        while (n--)
+            a += *data++, b += a;
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+// Slicing by 8.
+static unsigned int crc32(const unsigned int * t, const unsigned char * p, unsigned int size) {
+    unsigned int c = 0xFFFFFFFF;
+    for (; size >= 8; size -= 8, p += 8) {
+        unsigned int lo = c ^ load32(p), hi = load32(p + 4);
+        c = t[7 * 256 + (lo & 0xFF)] ^ t[6 * 256 + (lo >> 8 & 0xFF)] ^ t[5 * 256 + (lo >> 16 & 0xFF)] ^ t[4 * 256 + (lo >> 24)]
+          ^ t[3 * 256 + (hi & 0xFF)] ^ t[2 * 256 + (hi >> 8 & 0xFF)] ^ t[1 * 256 + (hi >> 16 & 0xFF)] ^ t[hi >> 24];
+    }
+    while (size--)
+        c = t[(c ^ *p++) & 0xFF] ^ c >> 8;
+    return c ^ 0xFFFFFFFF;
+}
+
+static void store32(unsigned char * p, unsigned int v) {
+    p[0] = v >> 24, p[1] = v >> 16, p[2] = v >> 8, p[3] = v;
+}
+
+// ARGB to RGB or RGBA.
+static void convert(const unsigned char * src, unsigned char * dst, unsigned int width, unsigned int bpp) {
+    unsigned int x = 0;
+    if (bpp == 4) {
+        __m128i mask = _mm_set1_epi32(0xFF00FF00);
+        for (; x + 4 <= width; x += 4) {
+            __m128i v = _mm_loadu_si128((__m128i *) (src + 4 * x));
+            __m128i rb = _mm_andnot_si128(mask, v);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128((__m128i *) (dst + 4 * x), _mm_or_si128(_mm_and_si128(v, mask), rb));
+        }
+    }
+    for (; x < width; x++) {
+        dst[bpp * x + 0] = src[4 * x + 2];
+        dst[bpp * x + 1] = src[4 * x + 1];
+        dst[bpp * x + 2] = src[4 * x + 0];
+        if (bpp == 4)
+            dst[bpp * x + 3] = src[4 * x + 3];
+    }
+}
+
+// Sum of the residuals as signed bytes, the usual estimate of how well a filtered row compresses.
+static inline __m128i cost(__m128i acc, __m128i v) {
+    __m128i m = _mm_min_epu8(v, _mm_sub_epi8(_mm_setzero_si128(), v));
+    return _mm_add_epi64(acc, _mm_sad_epu8(m, _mm_setzero_si128()));
+}
+
+static inline unsigned int total(__m128i acc) {
+    return _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+}
+
+static inline unsigned char paeth(int a, int b, int c) {
+    int pa = b - c, pb = a - c, pc = pa + pb;
+    pa = pa < 0 ? -pa : pa;
+    pb = pb < 0 ? -pb : pb;
+    pc = pc < 0 ? -pc : pc;
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+static inline __m128i abs16(__m128i v) {
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// Paeth predictor for 8 bytes widened to 16 bits.
+static inline __m128i paeth8(__m128i a, __m128i b, __m128i c) {
+    __m128i pa = abs16(_mm_sub_epi16(b, c));
+    __m128i pb = abs16(_mm_sub_epi16(a, c));
+    __m128i pc = abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+    __m128i use_a = _mm_and_si128(_mm_cmpgt_epi16(_mm_add_epi16(pb, _mm_set1_epi16(1)), pa), _mm_cmpgt_epi16(_mm_add_epi16(pc, _mm_set1_epi16(1)), pa));
+    __m128i use_b = _mm_andnot_si128(use_a, _mm_cmpgt_epi16(_mm_add_epi16(pc, _mm_set1_epi16(1)), pb));
+    __m128i use_c = _mm_andnot_si128(_mm_or_si128(use_a, use_b), _mm_set1_epi16(-1));
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(use_a, a), _mm_and_si128(use_b, b)), _mm_and_si128(use_c, c));
+}
+
+// Filters one row of n bytes. cur and up are preceded by bpp zero bytes. Writes the filter type and the row to out.
+static void filter(const unsigned char * cur, const unsigned char * up, unsigned int n, unsigned int bpp, unsigned char * rows[4], unsigned char * out) {
+    __m128i z = _mm_setzero_si128(), c0 = z, c1 = z, c2 = z, c4 = z;
+    unsigned int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((__m128i *) (cur + i));
+        __m128i a = _mm_loadu_si128((__m128i *) (cur + i - bpp));
+        __m128i b = _mm_loadu_si128((__m128i *) (up + i));
+        __m128i c = _mm_loadu_si128((__m128i *) (up + i - bpp));
+        __m128i sub = _mm_sub_epi8(x, a), upf = _mm_sub_epi8(x, b);
+        __m128i lo = paeth8(_mm_unpacklo_epi8(a, z), _mm_unpacklo_epi8(b, z), _mm_unpacklo_epi8(c, z));
+        __m128i hi = paeth8(_mm_unpackhi_epi8(a, z), _mm_unpackhi_epi8(b, z), _mm_unpackhi_epi8(c, z));
+        __m128i pth = _mm_sub_epi8(x, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128((__m128i *) (rows[1] + i), sub);
+        _mm_storeu_si128((__m128i *) (rows[2] + i), upf);
+        _mm_storeu_si128((__m128i *) (rows[3] + i), pth);
+        c0 = cost(c0, x), c1 = cost(c1, sub), c2 = cost(c2, upf), c4 = cost(c4, pth);
+    }
+    unsigned int s[4] = {total(c0), total(c1), total(c2), total(c4)};
+    const unsigned char * left = cur - bpp, * corner = up - bpp;
+    for (; i < n; i++) {
+        unsigned char v[4] = {cur[i], cur[i] - left[i], cur[i] - up[i], cur[i] - paeth(left[i], up[i], corner[i])};
+        for (int f = 0; f < 4; f++) {
+            rows[f][i] = v[f];
+            s[f] += (v[f] < 128) ? v[f] : 256 - v[f];
+        }
+    }
+
+    // Ties prefer the simpler filter.
+    int best = 0;
+    for (int f = 1; f < 4; f++)
+        if (s[f] < s[best])
+            best = f;
+    const unsigned char * src = (best == 0) ? cur : rows[best];
+    out[0] = (best == 3) ? 4 : best; // Paeth is filter type 4
+    for (i = 0; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *) (out + 1 + i), _mm_loadu_si128((__m128i *) (src + i)));
+    for (; i < n; i++)
+        out[1 + i] = src[i];
+}
+
+static void encode(struct png * r) {
+    unsigned int n = r->bpp * r->width, pitch = 1 + n, row = (4 * r->width + 48) & ~15;
+    unsigned char * rows[4], * buf[2];
+    unsigned char * scratch = r->work + SCRATCH;
+    for (int k = 0; k < 2; k++)
+        buf[k] = scratch + k * row + 16;
+    for (int k = 0; k < 4; k++)
+        rows[k] = scratch + (2 + k) * row + 16;
+    for (int i = -16; i < 0; i++)
+        buf[0][i] = buf[1][i] = 0;
+
+    // The row above the band, or zeros above the image.
+    unsigned char * cur = buf[0], * up = buf[1];
+    if (r->first > 0)
+        convert(r->pixels + (r->first - 1) * r->stride, up, r->width, r->bpp);
+    else
+        for (unsigned int i = 0; i < n; i++)
+            up[i] = 0;
+
+    unsigned char * filtered = r->filtered + r->first * pitch;
+    for (unsigned int y = r->first; y < r->last; y++) {
+        convert(r->pixels + y * r->stride, cur, r->width, r->bpp);
+        filter(cur, up, n, r->bpp, rows, r->filtered + y * pitch);
+        unsigned char * t = cur; cur = up; up = t;
+    }
+    unsigned int size = (r->last - r->first) * pitch;
+    r->adler = adler32(filtered, size);
+
+    // Chunk length and type, then the zlib header for the first band.
+    struct bits b = {r->out + 8, 0, 0};
+    if (r->first == 0)
+        put(&b, 0x0178, 16); // Deflate with a 32 KB window, no dictionary
+    deflate(r, &b, filtered, size);
+
+    // The last band ends the stream with an empty final block. Other bands end with an empty
+    // stored block, which aligns to a byte boundary without ending the stream.
+    if (r->last == r->height) {
+        put(&b, 3, 3);
+        put(&b, 0, 7);
+        align(&b);
+    }
+    else {
+        put(&b, 0, 3);
+        align(&b);
+        put(&b, 0xFFFF0000, 32);
+    }
+
+    unsigned int length = b.p - (r->out + 8);
+    store32(r->out, length);
+    r->out[4] = 'I', r->out[5] = 'D', r->out[6] = 'A', r->out[7] = 'T';
+    store32(b.p, crc32(r->crc, r->out + 4, length + 4));
+    r->size = length + 12;
+}
+
+static void setup(struct png * r) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320 ^ c >> 1 : c >> 1;
+        r->crc[i] = c;
+    }
+    for (unsigned int i = 0; i < 256; i++)
+        for (int t = 1; t < 8; t++)
+            r->crc[t * 256 + i] = r->crc[(t - 1) * 256 + i] >> 8 ^ r->crc[r->crc[(t - 1) * 256 + i] & 0xFF];
+
+    // RGB is enough when every pixel is opaque.
+    __m128i acc = _mm_set1_epi32(-1);
+    unsigned int alpha = 0xFF;
+    for (unsigned int y = 0; y < r->height; y++) {
+        unsigned int * p = (unsigned int *) (r->pixels + y * r->stride), x = 0;
+        for (; x + 4 <= r->width; x += 4)
+            acc = _mm_and_si128(acc, _mm_loadu_si128((__m128i *) (p + x)));
+        for (; x < r->width; x++)
+            alpha &= p[x] >> 24;
+    }
+    acc = _mm_and_si128(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_and_si128(acc, _mm_srli_si128(acc, 4));
+    alpha &= (unsigned int) _mm_cvtsi128_si32(acc) >> 24;
+    r->bpp = (alpha == 0xFF) ? 3 : 4;
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int png(struct png * r) {
+    if (r->pass == 0)
+        setup(r);
+    if (r->pass == 1)
+        encode(r);
+    return 0;
+}
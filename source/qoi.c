@@ -0,0 +1,152 @@
+// QOI encoder and decoder for 32-bit ARGB. See https://qoiformat.org/qoi-specification.pdf
+// Each pixel becomes a run, an index into the 64 most recently hashed colors, a small difference
+// from the previous pixel, or a literal. There is no entropy coding, so both directions are a single
+// pass that touches every pixel once. Pixels are compared and hashed as whole 32-bit words.
+typedef __SIZE_TYPE__ size_t;
+typedef __PTRDIFF_TYPE__ ptrdiff_t;
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xC0
+#define QOI_OP_RGB   0xFE
+#define QOI_OP_RGBA  0xFF
+
+// (r × 3 + g × 5 + b × 7 + a × 11) % 64
+static inline unsigned int hash(unsigned int px) {
+    return ((px >> 16 & 0xFF) * 3 + (px >> 8 & 0xFF) * 5 + (px & 0xFF) * 7 + (px >> 24) * 11) & 63;
+}
+
+static inline void store32(unsigned char * p, unsigned int v) {
+    p[0] = v >> 24, p[1] = v >> 16, p[2] = v >> 8, p[3] = v;
+}
+
+static inline unsigned int load32(const unsigned char * p) {
+    return (unsigned int) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static size_t encode(const unsigned char * pixels, unsigned int width, unsigned int height, int stride, unsigned char * out) {
+    unsigned int index[64] = {0}, prev = 0xFF000000, alpha = 0xFF000000, run = 0;
+    unsigned char * p = out + 14;
+
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned int * row = (const unsigned int *) (pixels + (ptrdiff_t) y * stride);
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int px = row[x];
+            alpha &= px;
+
+            if (px == prev) {
+                if (++run == 62) {
+                    *p++ = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run) {
+                *p++ = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+
+            unsigned int h = hash(px);
+            if (index[h] == px) {
+                *p++ = QOI_OP_INDEX | h;
+            }
+            else if ((px ^ prev) >> 24) {
+                *p++ = QOI_OP_RGBA;
+                *p++ = px >> 16, *p++ = px >> 8, *p++ = px, *p++ = px >> 24;
+            }
+            else {
+                signed char dr = (px >> 16) - (prev >> 16), dg = (px >> 8) - (prev >> 8), db = px - prev;
+                signed char dr_dg = dr - dg, db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    *p++ = QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+                else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    *p++ = QOI_OP_LUMA | (dg + 32);
+                    *p++ = (dr_dg + 8) << 4 | (db_dg + 8);
+                }
+                else {
+                    *p++ = QOI_OP_RGB;
+                    *p++ = px >> 16, *p++ = px >> 8, *p++ = px;
+                }
+            }
+            index[h] = px;
+            prev = px;
+        }
+    }
+    if (run)
+        *p++ = QOI_OP_RUN | (run - 1);
+
+    // End marker.
+    for (int i = 0; i < 7; i++)
+        *p++ = 0;
+    *p++ = 1;
+
+    // The header records 3 channels when every pixel is opaque. Colorspace 0 is sRGB with linear alpha.
+    out[0] = 'q', out[1] = 'o', out[2] = 'i', out[3] = 'f';
+    store32(out + 4, width);
+    store32(out + 8, height);
+    out[12] = (alpha == 0xFF000000) ? 3 : 4;
+    out[13] = 0;
+    return p - out;
+}
+
+static ptrdiff_t decode(const unsigned char * data, size_t size, unsigned char * pixels, unsigned int width, unsigned int height, int stride) {
+    if (size < 14 + 8 || load32(data) != 0x716F6966 || load32(data + 4) != width || load32(data + 8) != height)
+        return -1;
+
+    unsigned int index[64] = {0}, px = 0xFF000000, run = 0;
+    const unsigned char * p = data + 14, * end = data + size - 8; // The end marker is padding.
+
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned int * row = (unsigned int *) (pixels + (ptrdiff_t) y * stride);
+        for (unsigned int x = 0; x < width; x++) {
+            if (run) {
+                run--;
+                row[x] = px;
+                continue;
+            }
+            if (p >= end)
+                return -1;
+
+            unsigned int b = *p++;
+            if (b == QOI_OP_RGB) {
+                if (end - p < 3)
+                    return -1;
+                px = (px & 0xFF000000) | p[0] << 16 | p[1] << 8 | p[2];
+                p += 3;
+            }
+            else if (b == QOI_OP_RGBA) {
+                if (end - p < 4)
+                    return -1;
+                px = (unsigned int) p[3] << 24 | p[0] << 16 | p[1] << 8 | p[2];
+                p += 4;
+            }
+            else if ((b & 0xC0) == QOI_OP_INDEX) {
+                px = index[b];
+            }
+            else if ((b & 0xC0) == QOI_OP_DIFF) {
+                unsigned int r = (px >> 16) + (b >> 4 & 3) - 2, g = (px >> 8) + (b >> 2 & 3) - 2, bl = px + (b & 3) - 2;
+                px = (px & 0xFF000000) | (r & 0xFF) << 16 | (g & 0xFF) << 8 | (bl & 0xFF);
+            }
+            else if ((b & 0xC0) == QOI_OP_LUMA) {
+                if (end - p < 1)
+                    return -1;
+                int dg = (b & 0x3F) - 32, d = *p++;
+                unsigned int r = (px >> 16) + dg + (d >> 4) - 8, g = (px >> 8) + dg, bl = px + dg + (d & 15) - 8;
+                px = (px & 0xFF000000) | (r & 0xFF) << 16 | (g & 0xFF) << 8 | (bl & 0xFF);
+            }
+            else {
+                run = b & 0x3F;
+            }
+            index[hash(px)] = px;
+            row[x] = px;
+        }
+    }
+    return 0;
+}
+
+// op 0: Encodes the pixels into data, which holds 14 + 5 × width × height + 8 bytes. Returns the size.
+// op 1: Decodes size bytes of data into the pixels. Returns 0, or -1 if the data is not a QOI image of this size.
+ptrdiff_t qoi(int op, void * pixels, unsigned int width, unsigned int height, int stride, void * data, size_t size) {
+    return (op == 0) ? (ptrdiff_t) encode(pixels, width, height, stride, data) : decode(data, size, pixels, width, height, stride);
+}
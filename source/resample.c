@@ -0,0 +1,252 @@
+// Separable resampler for 32-bit ARGB. Replaces GdipDrawImageRectRectI in BitmapScale.
+// Pass 0 builds the fixed-point filter tables, pass 1 filters rows horizontally into a
+// premultiplied 16-bit intermediate, and pass 2 filters columns vertically into the destination.
+// Passes 1 and 2 only touch the rows [first, last) so that each can be split across threads.
+#include <emmintrin.h>
+
+struct resample {
+    unsigned int * src;         // Source pixels (ARGB)
+    unsigned int * dst;         // Destination pixels (ARGB)
+    short * tmp;                // Intermediate of dw × sh premultiplied pixels, 4 × int16 each
+    int * xbounds;              // First source column of each destination column
+    short * xweights;           // xtaps weights per destination column, summing to 1 << 14
+    int * ybounds;              // First source row of each destination row
+    short * yweights;           // ytaps weights per destination row, summing to 1 << 14
+    int sw, sh, sstride;        // Source width, height, stride in bytes
+    int dw, dh, dstride;        // Destination width, height, stride in bytes
+    int filter;                 // 0 = nearest, 1 = bilinear, 2 = bicubic, 3 = lanczos3, 4 = box
+    int xtaps, ytaps;           // Number of weights per destination pixel
+    int pass;                   // 0 = weights, 1 = horizontal, 2 = vertical
+    int first, last;            // Rows to process for passes 1 and 2
+};
+
+static double floor_(double x) {
+    int i = (int) x;
+    return (x < i) ? i - 1 : i;
+}
+
+// sin(πx) using a Taylor series after reducing x to [-0.5, 0.5]. Error < 4e-7.
+static double sinpi(double x) {
+    x = x - 2 * floor_((x + 1) / 2);       // [-1, 1)
+    if (x > 0.5) x = 1 - x;                 // sin(π - θ) = sin(θ)
+    if (x < -0.5) x = -1 - x;
+    double t = 3.14159265358979323846 * x, t2 = t * t;
+    return t * (1 - t2 / 6 * (1 - t2 / 20 * (1 - t2 / 42 * (1 - t2 / 72 * (1 - t2 / 110)))));
+}
+
+static double sinc(double x) {
+    return (x == 0) ? 1 : sinpi(x) / (3.14159265358979323846 * x);
+}
+
+static double support(int filter) {
+    switch (filter) {
+        case 1: return 1.0;
+        case 2: return 2.0;
+        case 3: return 3.0;
+        default: return 0.5;
+    }
+}
+
+static double kernel(int filter, double x) {
+    if (filter == 4)
+        return (-0.5 <= x && x < 0.5) ? 1 : 0;  // Half-open so that ties select exactly one pixel.
+    if (x < 0) x = -x;
+    switch (filter) {
+        case 1: return (x < 1) ? 1 - x : 0;
+        case 2: // Catmull-Rom (a = -0.5), the same family as HighQualityBicubic.
+            if (x < 1) return (1.5 * x - 2.5) * x * x + 1;
+            if (x < 2) return ((-0.5 * x + 2.5) * x - 4) * x + 2;
+            return 0;
+        case 3: return (x < 3) ? sinc(x) * sinc(x / 3) : 0;
+        default: return 0;
+    }
+}
+
+// Number of taps needed for one axis. Downscaling stretches the filter to cover every source pixel.
+static int taps(int filter, int n, int m) {
+    if (filter == 0)
+        return 1;
+    double fscale = (n > m) ? (double) n / m : 1.0;
+    int t = 2 * (int) (support(filter) * fscale + 0.999999) + 1;
+    return (t < n) ? t : n;
+}
+
+static void weights(int filter, int n, int m, int t, int * bounds, short * weights) {
+    double scale = (double) n / m;                   // Source pixels per destination pixel
+    double fscale = (scale > 1) ? scale : 1.0;
+
+    for (int i = 0; i < m; i++) {
+        double center = (i + 0.5) * scale;          // Center of the destination pixel in source space
+        int left = (int) floor_(center - t / 2.0 + 0.5);
+        int start = left < 0 ? 0 : (left + t > n ? n - t : left);
+        short * out = weights + i * t;
+
+        for (int k = 0; k < t; k++)
+            out[k] = 0;
+
+        if (filter == 0) {
+            int j = (int) floor_(center);
+            out[(j > n - 1 ? n - 1 : j) - start] = 16384;
+        }
+        else {
+            double total = 0;
+            for (int k = 0; k < t; k++)
+                total += kernel(filter, (left + k + 0.5 - center) / fscale);
+
+            // Fold weights that fall outside the image onto the nearest edge pixel.
+            for (int k = 0; k < t; k++) {
+                int j = left + k;
+                double v = kernel(filter, (j + 0.5 - center) / fscale) / total * 16384;
+                j = j < 0 ? 0 : (j > n - 1 ? n - 1 : j);
+                out[j - start] += (short) (v < 0 ? v - 0.5 : v + 0.5);
+            }
+
+            // Give the rounding error to the largest weight so that the weights sum to 1 << 14.
+            int sum = 0, max = 0;
+            for (int k = 0; k < t; k++) {
+                sum += out[k];
+                if (out[k] > out[max]) max = k;
+            }
+            out[max] += 16384 - sum;
+        }
+        bounds[i] = start;
+    }
+}
+
+// Unpacks two pixels to 16-bit lanes and premultiplies color by alpha with exact (c*a + 127) / 255 rounding.
+static inline __m128i premultiply(__m128i v, __m128i vzero, __m128i valpha) {
+    v = _mm_unpacklo_epi8(v, vzero);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF);
+    a = _mm_or_si128(_mm_andnot_si128(valpha, a), _mm_and_si128(valpha, _mm_set1_epi16(255)));
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(v, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static void horizontal(struct resample * r) {
+    __m128i vzero = _mm_setzero_si128();
+    __m128i valpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    __m128i vround = _mm_set1_epi32(1 << 7);
+
+    for (int y = r->first; y < r->last; y++) {
+        unsigned int * row = (unsigned int *) ((char *) r->src + y * r->sstride);
+        short * out = r->tmp + y * r->dw * 4;
+
+        for (int x = 0; x < r->dw; x++) {
+            unsigned int * p = row + r->xbounds[x];
+            short * w = r->xweights + x * r->xtaps;
+            __m128i acc = _mm_setzero_si128();
+            int k = 0;
+
+            // Two taps per multiply-add: [b0 b1 g0 g1 r0 r1 a0 a1] × [w0 w1 w0 w1 ...]
+            for (; k + 1 < r->xtaps; k += 2) {
+                __m128i v = premultiply(_mm_loadl_epi64((__m128i *) (p + k)), vzero, valpha);
+                v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+                __m128i vw = _mm_set1_epi32((unsigned short) w[k] | w[k + 1] << 16);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(v, vw));
+            }
+            if (k < r->xtaps) {
+                __m128i v = premultiply(_mm_cvtsi32_si128(p[k]), vzero, valpha);
+                v = _mm_unpacklo_epi16(v, vzero);
+                __m128i vw = _mm_set1_epi32((unsigned short) w[k]);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(v, vw));
+            }
+
+            // Keep 6 fractional bits so that overshoot and undershoot from negative lobes fit in a signed short.
+            acc = _mm_srai_epi32(_mm_add_epi32(acc, vround), 8);
+            acc = _mm_packs_epi32(acc, acc);
+            _mm_storel_epi64((__m128i *) (out + 4 * x), acc);
+        }
+    }
+}
+
+// Divides color by alpha, clamping ringing from negative lobes so that color never exceeds alpha.
+static inline unsigned int unpremultiply(unsigned int c) {
+    unsigned int a = c >> 24;
+    if (a == 0)
+        return 0;
+    if (a == 255)
+        return c;
+    unsigned int inv = ((255 << 16) + a / 2) / a;
+    unsigned int r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+    r = r > a ? a : r;
+    g = g > a ? a : g;
+    b = b > a ? a : b;
+    r = (r * inv + 32768) >> 16;
+    g = (g * inv + 32768) >> 16;
+    b = (b * inv + 32768) >> 16;
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+static void vertical(struct resample * r) {
+    __m128i vround = _mm_set1_epi32(1 << 19);
+    int stride = r->dw * 4;
+
+    for (int y = r->first; y < r->last; y++) {
+        short * col = r->tmp + r->ybounds[y] * stride;
+        short * w = r->yweights + y * r->ytaps;
+        unsigned int * out = (unsigned int *) ((char *) r->dst + y * r->dstride);
+        int x = 0;
+
+        // Two pixels (8 lanes) per iteration.
+        for (; x + 1 < r->dw; x += 2) {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            short * p = col + 4 * x;
+            int k = 0;
+            for (; k + 1 < r->ytaps; k += 2) {
+                __m128i r0 = _mm_loadu_si128((__m128i *) (p + k * stride));
+                __m128i r1 = _mm_loadu_si128((__m128i *) (p + (k + 1) * stride));
+                __m128i vw = _mm_set1_epi32((unsigned short) w[k] | w[k + 1] << 16);
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), vw));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), vw));
+            }
+            if (k < r->ytaps) {
+                __m128i r0 = _mm_loadu_si128((__m128i *) (p + k * stride));
+                __m128i vw = _mm_set1_epi32((unsigned short) w[k]);
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(r0, _mm_setzero_si128()), vw));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(r0, _mm_setzero_si128()), vw));
+            }
+            lo = _mm_srai_epi32(_mm_add_epi32(lo, vround), 20);
+            hi = _mm_srai_epi32(_mm_add_epi32(hi, vround), 20);
+            __m128i v = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+            unsigned int c0 = _mm_cvtsi128_si32(v);
+            unsigned int c1 = _mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+            out[x] = unpremultiply(c0);
+            out[x + 1] = unpremultiply(c1);
+        }
+
+        // Clean up the last pixel of odd widths.
+        if (x < r->dw) {
+            int acc[4] = {0, 0, 0, 0};
+            short * p = col + 4 * x;
+            for (int k = 0; k < r->ytaps; k++)
+                for (int c = 0; c < 4; c++)
+                    acc[c] += p[k * stride + c] * w[k];
+            unsigned int v = 0;
+            for (int c = 0; c < 4; c++) {
+                int i = (acc[c] + (1 << 19)) >> 20;
+                v |= (unsigned int) (i < 0 ? 0 : (i > 255 ? 255 : i)) << (8 * c);
+            }
+            out[x] = unpremultiply(v);
+        }
+    }
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int resample(struct resample * r) {
+    if (r->pass == 0) {
+        r->xtaps = taps(r->filter, r->sw, r->dw);
+        r->ytaps = taps(r->filter, r->sh, r->dh);
+        if (r->xweights && r->yweights) {
+            weights(r->filter, r->sw, r->dw, r->xtaps, r->xbounds, r->xweights);
+            weights(r->filter, r->sh, r->dh, r->ytaps, r->ybounds, r->yweights);
+        }
+    }
+    if (r->pass == 1)
+        horizontal(r);
+    if (r->pass == 2)
+        vertical(r);
+    return 0;
+}
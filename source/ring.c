@@ -0,0 +1,100 @@
+// Lock-free ring of pre-allocated frames shared by one producer (capture) and one consumer (analysis).
+// Each slot moves through FREE → WRITING → READY → READING → FREE using compare-and-swap, so the
+// producer never waits on the consumer and the consumer never sees a frame that is still being written.
+// When every slot is taken, the policy decides whether the oldest unread frame or the new frame is dropped.
+// Readers also claim slots with compare-and-swap, so several worker threads may consume frames at once.
+// Only compiler builtins are used, so this file builds for Windows machine code and for tests on Linux.
+
+#define FREE    0
+#define WRITING 1
+#define READY   2
+#define READING 3
+
+struct ring {
+    unsigned char * pixels;          // capacity × size bytes of pixels
+    unsigned int * state;            // FREE, WRITING, READY, or READING for each slot
+    unsigned int * sequence;         // Frame number of each slot, starting at 1
+    unsigned int capacity;           // Number of slots
+    unsigned int size;               // Bytes per slot, at least stride × height
+    unsigned int width, height, stride; // Frame dimensions, stride in bytes
+    unsigned int policy;             // 0 = drop oldest, 1 = drop newest
+    unsigned int written;            // Frames published
+    unsigned int dropped;            // Frames discarded by the policy
+    unsigned int cursor;             // Next slot for the producer to try
+};
+
+static int transition(unsigned int * state, unsigned int from, unsigned int to) {
+    return __atomic_compare_exchange_n(state, &from, to, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// The slot in the given state with the lowest frame number, or -1.
+static int oldest(struct ring * r, unsigned int state) {
+    int slot = -1;
+    for (unsigned int i = 0; i < r->capacity; i++)
+        if (__atomic_load_n(r->state + i, __ATOMIC_ACQUIRE) == state)
+            if (slot < 0 || (int) (r->sequence[i] - r->sequence[slot]) < 0)
+                slot = i;
+    return slot;
+}
+
+static int acquire_write(struct ring * r) {
+    // Prefer free slots in ring order.
+    for (unsigned int k = 0; k < r->capacity; k++) {
+        unsigned int i = (r->cursor + k) % r->capacity;
+        if (transition(r->state + i, FREE, WRITING))
+            return i;
+    }
+
+    // Overwrite the oldest unread frame. Retry if the consumer claims it first.
+    while (r->policy == 0) {
+        int i = oldest(r, READY);
+        if (i < 0)
+            break; // Every slot is being read or written.
+        if (transition(r->state + i, READY, WRITING)) {
+            __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+            return i;
+        }
+    }
+    __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+    return -1;
+}
+
+static void publish(struct ring * r, int i, unsigned char * src, int pitch) {
+    // Copy the rows of the source into the slot when given.
+    if (src) {
+        unsigned char * dst = r->pixels + (unsigned int) i * r->size;
+        for (unsigned int y = 0; y < r->height; y++) {
+            unsigned int * s = (unsigned int *) (src + (int) y * pitch);
+            unsigned int * d = (unsigned int *) (dst + y * r->stride);
+            for (unsigned int x = 0; x < r->width; x++)
+                d[x] = s[x];
+        }
+    }
+    r->sequence[i] = __atomic_add_fetch(&r->written, 1, __ATOMIC_RELAXED);
+    r->cursor = i + 1;
+    __atomic_store_n(r->state + i, READY, __ATOMIC_RELEASE);
+}
+
+static int acquire_read(struct ring * r) {
+    for (;;) {
+        int i = oldest(r, READY);
+        if (i < 0)
+            return -1;
+        if (transition(r->state + i, READY, READING))
+            return i;
+    }
+}
+
+// op 0: Returns a slot to write into, or -1 if the frame must be dropped.
+// op 1: Copies src (when not null) into the slot and publishes it as the next frame.
+// op 2: Returns the oldest unread slot, or -1 if there are none.
+// op 3: Returns a slot that has been read to the producer.
+int ring(struct ring * r, int op, int slot, unsigned char * src, int pitch) {
+    switch (op) {
+        case 0: return acquire_write(r);
+        case 1: publish(r, slot, src, pitch); return slot;
+        case 2: return acquire_read(r);
+        case 3: __atomic_store_n(r->state + slot, FREE, __ATOMIC_RELEASE); return slot;
+    }
+    return -1;
+}
@@ -0,0 +1,77 @@
+// The 2D rolling hash shared by imagesearch4 and imagesearchall4.
+#ifndef ROLLING_HASH
+#define ROLLING_HASH
+#define ROW_BASE 0x01000193u                        // Odd, so that no power of either base is zero
+#define COLUMN_BASE 0x9E3779B1u
+
+static unsigned int power(unsigned int b, unsigned int n) {
+    unsigned int r = 1;
+    while (n--)
+        r *= b;
+    return r;
+}
+
+// p[0] × B^(w-1) + p[1] × B^(w-2) + ... + p[w-1]
+static unsigned int row_hash(const unsigned int * p, unsigned int w) {
+    unsigned int hash = 0;
+    for (unsigned int j = 0; j < w; j++)
+        hash = hash * ROW_BASE + p[j];
+    return hash;
+}
+
+// The row hashes of the needle, combined from the top row down.
+static unsigned int needle_hash(const unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch) {
+    unsigned int hash = 0;
+    for (unsigned int i = 0; i < h; i++)
+        hash = hash * COLUMN_BASE + row_hash(s + i * pitch, w);
+    return hash;
+}
+
+// Returns 0 if the needle matches at p, or else the number of pixels compared up to the first difference.
+static unsigned int differ(const unsigned int * p, unsigned int stride, const unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch) {
+    for (unsigned int i = 0; i < h; i++)
+        for (unsigned int j = 0; j < w; j++)
+            if (*((unsigned char *) (s + i * pitch + j) + 3)) // Skip transparent pixels
+                if (s[i * pitch + j] != p[i * stride + j])
+                    return i * w + j + 1;
+    return 0;
+}
+
+static int opaque(const unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch) {
+    for (unsigned int i = 0; i < h; i++)
+        for (unsigned int j = 0; j < w; j++)
+            if (*((unsigned char *) (s + i * pitch + j) + 3) == 0)
+                return 0;
+    return 1;
+}
+
+// Sets each column hash to the hash of the h rows starting at start.
+static void first_rows(unsigned int * columns, const unsigned int * start, unsigned int width, unsigned int stride, unsigned int w, unsigned int h, unsigned int bw) {
+    unsigned int n = width - w + 1;
+    for (unsigned int x = 0; x < n; x++)
+        columns[x] = 0;
+    for (unsigned int i = 0; i < h; i++) {
+        const unsigned int * row = start + i * stride;
+        unsigned int hash = row_hash(row, w);
+        for (unsigned int x = 0; x < n; x++) {
+            columns[x] = columns[x] * COLUMN_BASE + hash;
+            if (x + 1 < n)
+                hash = (hash - row[x] * bw) * ROW_BASE + row[x + w];
+        }
+    }
+}
+
+// Moves each column hash down one row: the row at top leaves and the row at top + h enters.
+static void next_row(unsigned int * columns, const unsigned int * top, unsigned int width, unsigned int stride, unsigned int w, unsigned int h, unsigned int bw, unsigned int ch) {
+    unsigned int n = width - w + 1;
+    const unsigned int * bottom = top + h * stride;
+    unsigned int out = row_hash(top, w), in = row_hash(bottom, w);
+    for (unsigned int x = 0; x < n; x++) {
+        columns[x] = (columns[x] - out * ch) * COLUMN_BASE + in;
+        if (x + 1 < n) {
+            out = (out - top[x] * bw) * ROW_BASE + top[x + w];
+            in = (in - bottom[x] * bw) * ROW_BASE + bottom[x + w];
+        }
+    }
+}
+#endif
@@ -0,0 +1,136 @@
+// Rotates and flips 32-bit ARGB into any of the 8 EXIF orientations:
+//   1 - as is                  5 - transpose (mirror across the main diagonal)
+//   2 - flip horizontally      6 - rotate 90° clockwise
+//   3 - rotate 180°            7 - transverse (mirror across the other diagonal)
+//   4 - flip vertically        8 - rotate 90° counterclockwise
+// Orientations 1 to 4 swap pairs of rows, so they can run in place with src equal to dst. [first, last) are
+// the first rows of each pair: all height rows for 1 and 2, and the top (height + 1) / 2 rows for 3 and 4.
+// Orientations 5 to 8 exchange rows and columns, so they need a separate dst of height × width. [first, last)
+// are rows of dst, written in tiles that keep the columns of src in the cache, with 4 × 4 blocks transposed
+// in registers. Both can be split across threads.
+#include <emmintrin.h>
+
+typedef __SIZE_TYPE__ size_t;
+
+#define TILE 64
+
+struct rotate {
+    unsigned int * src;             // Source pixels (ARGB)
+    unsigned int * dst;             // Destination pixels, the same as src to flip in place
+    unsigned int width, height;     // Source dimensions
+    unsigned int sstride, dstride;  // Strides in bytes
+    unsigned int orientation;       // 1 to 8, given as the pass of ImagePut.Parallel
+    unsigned int first, last;       // Rows of this thread
+};
+
+static unsigned int * row_of(unsigned int * pixels, unsigned int stride, unsigned int y) {
+    return (unsigned int *) ((unsigned char *) pixels + (size_t) y * stride);
+}
+
+// Writes rows a and b of dst from rows b and a of src, mirrored if reversed. All of each pair of blocks is read
+// before any of it is written, so rows may be the same row and src may be dst.
+static void swap_rows(struct rotate * r, unsigned int a, unsigned int b, int reversed) {
+    unsigned int * sa = row_of(r->src, r->sstride, a), * sb = row_of(r->src, r->sstride, b);
+    unsigned int * da = row_of(r->dst, r->dstride, a), * db = row_of(r->dst, r->dstride, b);
+    unsigned int w = r->width, i = 0;
+
+    if (!reversed) {
+        for (; i + 4 <= w; i += 4) {
+            __m128i pa = _mm_loadu_si128((__m128i *) (sa + i)), pb = _mm_loadu_si128((__m128i *) (sb + i));
+            _mm_storeu_si128((__m128i *) (da + i), pb);
+            _mm_storeu_si128((__m128i *) (db + i), pa);
+        }
+        for (; i < w; i++) {
+            unsigned int pa = sa[i], pb = sb[i];
+            da[i] = pb, db[i] = pa;
+        }
+        return;
+    }
+
+    // Blocks from both ends of the rows move to the opposite ends, until they would meet.
+    for (; 2 * i + 8 <= w; i += 4) {
+        unsigned int j = w - 4 - i;
+        __m128i la = _mm_loadu_si128((__m128i *) (sa + i)), ra = _mm_loadu_si128((__m128i *) (sa + j));
+        __m128i lb = _mm_loadu_si128((__m128i *) (sb + i)), rb = _mm_loadu_si128((__m128i *) (sb + j));
+        _mm_storeu_si128((__m128i *) (da + i), _mm_shuffle_epi32(rb, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_si128((__m128i *) (da + j), _mm_shuffle_epi32(lb, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_si128((__m128i *) (db + i), _mm_shuffle_epi32(ra, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_si128((__m128i *) (db + j), _mm_shuffle_epi32(la, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    for (; 2 * i < w; i++) {
+        unsigned int j = w - 1 - i;
+        unsigned int la = sa[i], ra = sa[j], lb = sb[i], rb = sb[j];
+        da[i] = rb, da[j] = lb, db[i] = ra, db[j] = la;
+    }
+}
+
+// Pixel (x, y) of dst is pixel (x0 + dx × y, y0 + dy × x) of src.
+struct walk {
+    int x0, y0, dx, dy;
+};
+
+static unsigned int * source_row(struct rotate * r, struct walk * k, unsigned int x) {
+    return row_of(r->src, r->sstride, k->y0 + k->dy * (int) x);
+}
+
+static void pixels(struct rotate * r, struct walk * k, unsigned int y, unsigned int x, unsigned int end) {
+    unsigned int * d = row_of(r->dst, r->dstride, y);
+    for (; x < end; x++)
+        d[x] = source_row(r, k, x)[k->x0 + k->dx * (int) y];
+}
+
+// Transposes the 4 × 4 block of dst at (x, y), from 4 rows of src read left to right.
+static void block(struct rotate * r, struct walk * k, unsigned int y, unsigned int x) {
+    int column = (k->dx > 0) ? k->x0 + (int) y : k->x0 - (int) y - 3;
+    __m128i r0 = _mm_loadu_si128((__m128i *) (source_row(r, k, x + 0) + column));
+    __m128i r1 = _mm_loadu_si128((__m128i *) (source_row(r, k, x + 1) + column));
+    __m128i r2 = _mm_loadu_si128((__m128i *) (source_row(r, k, x + 2) + column));
+    __m128i r3 = _mm_loadu_si128((__m128i *) (source_row(r, k, x + 3) + column));
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+    __m128i c[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+
+    // Column j of the block read from src is row j of dst, counted from the bottom when src is read backwards.
+    for (int j = 0; j < 4; j++)
+        _mm_storeu_si128((__m128i *) (row_of(r->dst, r->dstride, y + (k->dx > 0 ? j : 3 - j)) + x), c[j]);
+}
+
+static void transpose(struct rotate * r) {
+    int w = r->width, h = r->height;
+    struct walk k = {
+        (r->orientation == 7 || r->orientation == 8) ? w - 1 : 0,
+        (r->orientation == 6 || r->orientation == 7) ? h - 1 : 0,
+        (r->orientation == 7 || r->orientation == 8) ? -1 : 1,
+        (r->orientation == 6 || r->orientation == 7) ? -1 : 1};
+    unsigned int columns = r->height;
+
+    for (unsigned int ty = r->first; ty < r->last; ty += TILE) {
+        unsigned int ylim = (ty + TILE < r->last) ? ty + TILE : r->last;
+        for (unsigned int tx = 0; tx < columns; tx += TILE) {
+            unsigned int xlim = (tx + TILE < columns) ? tx + TILE : columns;
+            unsigned int y = ty;
+            for (; y + 4 <= ylim; y += 4) {
+                unsigned int x = tx;
+                for (; x + 4 <= xlim; x += 4)
+                    block(r, &k, y, x);
+                for (unsigned int j = 0; j < 4; j++)
+                    pixels(r, &k, y + j, x, xlim);
+            }
+            for (; y < ylim; y++)
+                pixels(r, &k, y, tx, xlim);
+        }
+    }
+}
+
+#ifndef __x86_64__
+__attribute__((stdcall))
+#endif
+unsigned int rotate(struct rotate * r) {
+    if (r->orientation >= 5)
+        transpose(r);
+    else
+        for (unsigned int y = r->first; y < r->last; y++)
+            swap_rows(r, y, (r->orientation <= 2) ? y : r->height - 1 - y, r->orientation == 2 || r->orientation == 3);
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Round trips and invalid input for source/base64.c at every SIMD level the CPU supports.
+// Build and run on Linux: gcc -O2 test/native/base64.c -o base64 && ./base64
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../source/base64.c"
+
+#define MAX 300
+
+// Straightforward reference encoder.
+static size_t reference(const unsigned char * bin, size_t size, unsigned short * str, int url) {
+    const char * a = alphabet[url];
+    size_t n = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        unsigned int v = bin[i] << 16 | (i + 1 < size ? bin[i + 1] << 8 : 0) | (i + 2 < size ? bin[i + 2] : 0);
+        str[n++] = a[v >> 18];
+        str[n++] = a[v >> 12 & 63];
+        str[n++] = (i + 1 < size) ? a[v >> 6 & 63] : '=';
+        str[n++] = (i + 2 < size) ? a[v & 63] : '=';
+    }
+    return n;
+}
+
+int main(void) {
+    static unsigned char bin[MAX + 32], out[MAX + 32];
+    static unsigned short expect[2 * MAX], str[2 * MAX];
+    int simd = level(), failures = 0;
+    srand(1);
+
+    for (int url = 0; url <= 1; url++)
+        for (size_t size = 0; size <= MAX; size++) {
+            for (size_t i = 0; i < size; i++)
+                bin[i] = rand();
+            size_t length = reference(bin, size, expect, url);
+
+            // The public entry point, then each SIMD level on its own.
+            failures += base64(0, bin, size, str, url) != (ptrdiff_t) length || memcmp(str, expect, 2 * length) || str[length];
+            if (simd >= 1) {
+                size_t n = encode_blocks_ssse3(bin, size, str, url);
+                failures += n % 12 || memcmp(str, expect, n / 3 * 8);
+                n = decode_blocks_ssse3(expect, length, out, url);
+                failures += n % 16 || memcmp(out, bin, n / 4 * 3);
+            }
+            if (simd >= 2) {
+                size_t n = encode_blocks_avx2(bin, size, str, url);
+                failures += n % 24 || memcmp(str, expect, n / 3 * 8);
+                n = decode_blocks_avx2(expect, length, out, url);
+                failures += n % 32 || memcmp(out, bin, n / 4 * 3);
+            }
+
+            // Decode with and without padding.
+            failures += base64(1, expect, length, out, url) != (ptrdiff_t) size || memcmp(out, bin, size);
+            size_t bare = length;
+            while (bare && expect[bare - 1] == '=')
+                bare--;
+            failures += base64(1, expect, bare, out, url) != (ptrdiff_t) size || memcmp(out, bin, size);
+
+            // Any character outside the alphabet is rejected wherever it appears.
+            static const unsigned short bad[] = {' ', '\n', '.', '@', '[', '`', '{', 0x80, 0xFF, 0x141, 0};
+            for (size_t i = 0; i < bare; i += 7) {
+                unsigned short c = expect[i];
+                for (size_t k = 0; k < sizeof(bad) / sizeof(*bad); k++) {
+                    expect[i] = bad[k];
+                    failures += base64(1, expect, length, out, url) != -1;
+                }
+                expect[i] = url ? '+' : '-'; // The other alphabet
+                failures += base64(1, expect, length, out, url) != -1;
+                expect[i] = c;
+            }
+        }
+
+    // Lengths that cannot come from an encoder, misplaced padding, and unused bits that are not zero.
+    static const char * invalid[] = {"A", "AAAAA", "A===", "AA=", "AA=A", "AAA==", "AAAA====", "AB==", "AAB=", "=AAA"};
+    for (size_t k = 0; k < sizeof(invalid) / sizeof(*invalid); k++) {
+        size_t n = strlen(invalid[k]);
+        for (size_t i = 0; i < n; i++)
+            str[i] = invalid[k][i];
+        failures += base64(1, str, n, out, 0) != -1;
+    }
+
+    printf("%s base64 at SIMD level %d: %d failures\n", failures ? "FAIL" : "PASS", simd, failures);
+    return failures != 0;
+}
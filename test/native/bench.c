@@ -0,0 +1,629 @@
+// Benchmarks every kernel in source/ over synthetic haystacks at 1080p, 4K, and 8K.
+// Build and run on Linux: gcc -O2 test/native/bench.c -o bench && ./bench [filter] [--quick]
+// filter keeps the kernels whose names contain it. --quick only runs 1080p.
+// Output is tab separated with a header row. Lines starting with # are comments.
+//   kernel    - function name, followed by /variant when the same kernel is run in more than one way
+//   haystack  - solid, noise, ui (flat panels, gradients, and text), or nearmiss (almost matches everywhere)
+//   size      - haystack width × height
+//   needle    - needle width × height for image searches, number of colors for color lists, or -
+//   hit       - none, middle, or end: where the match is planted
+//   variation - per channel tolerance, or - when the kernel has none
+//   pixels    - haystack pixels visited, up to and including the match
+//   ms        - best time of several runs
+//   GB/s, ns/px, cycles/px - throughput over the pixels visited. Cycles are TSC ticks.
+// Each kernel is included as is, so the numbers are for the same C that the machine code is made from.
+// ring.c, channel.c, and pipeline.c coordinate threads and are exercised by their own tests. cpuid.c reads no pixels.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "../../source/checkalpha.c"
+#include "../../source/colorkey.c"
+#include "../../source/from_sprite.c"
+#include "../../source/setalpha.c"
+#include "../../source/transcolor.c"
+#include "../../source/pixelsearch1.c"
+#include "../../source/pixelsearch1x.c"
+#include "../../source/pixelsearch1x2.c"
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include "../../source/pixelsearch1y.c"
+#pragma GCC pop_options
+#include "../../source/pixelsearch1b.c"
+#include "../../source/pixelsearch2.c"
+#include "../../source/pixelsearch2x.c"
+#include "../../source/pixelsearch3.c"
+#include "../../source/pixelsearch3x.c"
+#include "../../source/pixelsearch4.c"
+#include "../../source/pixelsearch4x.c"
+#include "../../source/pixelsearch5x.c"
+#include "../../source/pixelsearchall1.c"
+#include "../../source/pixelsearchall1x.c"
+#include "../../source/pixelsearchall2.c"
+#include "../../source/pixelsearchall2x.c"
+#include "../../source/pixelsearchall3.c"
+#include "../../source/pixelsearchall3x.c"
+#include "../../source/pixelsearchall4.c"
+#include "../../source/pixelsearchall4x.c"
+#include "../../source/pixelsearchall5x.c"
+#include "../../source/imagesearch1.c"
+#include "../../source/imagesearch2.c"
+#include "../../source/imagesearch3.c"
+#include "../../source/imagesearch4.c"
+#include "../../source/imagesearch1b.c"
+#include "../../source/imagesearch5.c"
+#include "../../source/imagesearchall1.c"
+#include "../../source/imagesearchall4.c"
+#define within imagesearchall2_within
+#include "../../source/imagesearchall2.c"
+#undef within
+#include "../../source/resample.c"
+#include "../../source/palette.c"
+#include "../../source/bitmapequal.c"
+#include "../../source/pixelhash.c"
+#include "../../source/phash.c"
+#include "../../source/integral.c"
+#include "../../source/pack.c"
+#include "../../source/rotate.c"
+#include "../../source/composite.c"
+
+// The codecs share the names of their static helpers.
+#define level hex_level
+#define encode_blocks_ssse3 hex_encode_blocks_ssse3
+#define encode_blocks_avx2 hex_encode_blocks_avx2
+#define encode hex_encode
+#define classify_ssse3 hex_classify_ssse3
+#define decode_blocks_ssse3 hex_decode_blocks_ssse3
+#define decode_blocks_avx2 hex_decode_blocks_avx2
+#define decode hex_decode
+#include "../../source/hex.c"
+#undef level
+#undef encode_blocks_ssse3
+#undef encode_blocks_avx2
+#undef encode
+#undef classify_ssse3
+#undef decode_blocks_ssse3
+#undef decode_blocks_avx2
+#undef decode
+#include "../../source/base64.c"
+#define encode png_encode
+#include "../../source/png.c"
+#undef encode
+#define hash qoi_hash
+#define store32 qoi_store32
+#define load32 qoi_load32
+#define encode qoi_encode
+#define decode qoi_decode
+#include "../../source/qoi.c"
+#undef hash
+#undef store32
+#undef load32
+#undef encode
+#undef decode
+#include "test.h"
+
+#define COLOR  0xFF3A7BD5u // Searched for
+#define NEAR   0xFF3A7BE6u // Blue is 17 away from COLOR, outside of the variation
+#define SOLID  0xFF202020u
+#define RESULTS 1024
+
+enum { SOLID_HAY, NOISE_HAY, UI_HAY, NEARMISS_HAY, HAYSTACKS };
+static const char * haystack_names[] = {"solid", "noise", "ui", "nearmiss"};
+enum { HIT_NONE, HIT_MIDDLE, HIT_END, HITS };
+static const char * hit_names[] = {"none", "middle", "end"};
+
+struct job {
+    unsigned int * hay;              // width × height pixels, stride = 4 × width
+    unsigned int width, height;
+    unsigned int * needle;           // w × h pixels
+    unsigned int w, h;
+    unsigned int variation;
+    unsigned int * scratch;          // Output for transforms and codecs
+    unsigned char * work;            // More output for codecs
+    unsigned int ** results;         // RESULTS pointers for the search all kernels
+    unsigned int * saved;            // Haystack pixels under a planted match
+};
+
+// The variations below never reach the haystack colors, so only planted pixels match.
+static void make_haystack(unsigned int * p, unsigned int width, unsigned int height, int kind) {
+    size_t n = (size_t) width * height;
+    if (kind == SOLID_HAY || kind == NEARMISS_HAY) {
+        unsigned int c = (kind == SOLID_HAY) ? SOLID : NEAR;
+        for (size_t i = 0; i < n; i++)
+            p[i] = c;
+    }
+    if (kind == NOISE_HAY)
+        for (size_t i = 0; i < n; i++)
+            p[i] = 0xFF000000 | (next() & 0x1FFFFF); // Red below 0x20 keeps clear of COLOR
+    if (kind == UI_HAY) {
+        // Panels of flat color with a gradient title bar, and rows of dark glyph-like specks.
+        static const unsigned int palette[] = {0xFFF0F0F0, 0xFFFFFFFF, 0xFFE1E1E1, 0xFF2B2B2B, 0xFF0078D7, 0xFFCCE4F7};
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++) {
+                unsigned int panel = (x / 480 + y / 270 * 3) % 6, c = palette[panel];
+                if (y % 270 < 24)
+                    c = 0xFF000000 | (x % 480 * 255 / 480) << 16 | 0x4040;
+                else if (y % 18 < 10 && x % 480 > 16 && x % 9 < 5 && (x / 9 * 7 + y / 18 * 13) % 5)
+                    c = 0xFF101010 | (next() & 0x0F0F0F);
+                p[(size_t) y * width + x] = c;
+            }
+    }
+}
+
+// Needles are noise, except in the nearmiss haystack where every position matches the ranked pixels
+// and the first row, then fails on the second row.
+static void make_needle(struct job * j, int kind) {
+    for (unsigned int i = 0; i < j->w * j->h; i++)
+        j->needle[i] = (kind == NEARMISS_HAY) ? NEAR : 0xFF800000 | next();
+    j->needle[0] = COLOR;
+    if (kind == NEARMISS_HAY) {
+        j->needle[0] = NEAR;
+        j->needle[(j->h > 1) ? j->w : 0] = COLOR;
+    }
+}
+
+// Copies the needle (or COLOR) into the haystack. Returns the pixels visited up to and including the match.
+static size_t plant(struct job * j, int hit, int image, int restore) {
+    if (hit == HIT_NONE)
+        return (size_t) j->width * j->height;
+    unsigned int w = image ? j->w : 1, h = image ? j->h : 1;
+    unsigned int x = (hit == HIT_MIDDLE) ? (j->width - w) / 2 : j->width - w;
+    unsigned int y = (hit == HIT_MIDDLE) ? (j->height - h) / 2 : j->height - h;
+    for (unsigned int i = 0; i < h; i++)
+        for (unsigned int k = 0; k < w; k++) {
+            unsigned int * p = j->hay + (size_t) (y + i) * j->width + x + k;
+            if (restore)
+                *p = j->saved[i * w + k];
+            else
+                j->saved[i * w + k] = *p, *p = image ? j->needle[i * j->w + k] : COLOR;
+        }
+    return (size_t) y * j->width + x + 1;
+}
+
+// Returns a pointer to the hit, or 0. Variation is per channel.
+typedef void * (* kernel_t)(struct job * j);
+
+#define END(j) ((j)->hay + (size_t) (j)->width * (j)->height)
+#define RANGE(c, v, s) ((((c) >> (s)) & 0xFF) + (v) > 255 ? 255 : (((c) >> (s)) & 0xFF) + (v)), ((((c) >> (s)) & 0xFF) < (v) ? 0 : (((c) >> (s)) & 0xFF) - (v))
+#define MISS(p, j) ((void *) (p) == (void *) END(j) ? 0 : (void *) (p))
+
+// The first three colors are decoys that do not occur in any haystack.
+static unsigned int colors[4] = {0xFFF10203, 0xFFF40506, 0xFFF70809, COLOR};
+static unsigned int highs[4], lows[4];
+
+static void set_ranges(unsigned int v) {
+    for (int i = 0; i < 4; i++) {
+        highs[i] = lows[i] = 0xFF000000;
+        for (int shift = 0; shift < 24; shift += 8) {
+            unsigned int c = colors[i] >> shift & 0xFF;
+            highs[i] |= (c + v > 255 ? 255 : c + v) << shift;
+            lows[i] |= (c < v ? 0 : c - v) << shift;
+        }
+    }
+}
+
+static void * k_pixelsearch1(struct job * j) { return MISS(pixelsearch1(j->hay, END(j), COLOR), j); }
+static void * k_pixelsearch1x(struct job * j) { return MISS(pixelsearch1x(j->hay, END(j), COLOR), j); }
+static void * k_pixelsearch1x2(struct job * j) { return MISS(pixelsearch1x2(j->hay, END(j), COLOR), j); }
+static void * k_pixelsearch1y(struct job * j) { return MISS(pixelsearch1y(j->hay, END(j), COLOR), j); }
+static void * k_pixelsearch2(struct job * j) {
+    return MISS(pixelsearch2(j->hay, END(j), RANGE(COLOR, j->variation, 16), RANGE(COLOR, j->variation, 8), RANGE(COLOR, j->variation, 0)), j);
+}
+static void * k_pixelsearch2x(struct job * j) {
+    return MISS(pixelsearch2x(j->hay, END(j), RANGE(COLOR, j->variation, 16), RANGE(COLOR, j->variation, 8), RANGE(COLOR, j->variation, 0)), j);
+}
+static void * k_pixelsearch3(struct job * j) { return MISS(pixelsearch3(j->hay, END(j), colors, 4), j); }
+static void * k_pixelsearch3x(struct job * j) { return MISS(pixelsearch3x(j->hay, END(j), colors, 4), j); }
+static void * k_pixelsearch4(struct job * j) { return MISS(pixelsearch4(j->hay, END(j), highs, lows, 4), j); }
+static void * k_pixelsearch4x(struct job * j) { return MISS(pixelsearch4x(j->hay, END(j), highs, lows, 4), j); }
+
+// Color distances that reach COLOR from the planted pixels but not NEAR, the closest haystack color.
+#define RGB_DISTANCE 10.0f
+#define LAB_DISTANCE 2.3f
+static void * k_pixelsearch5x_rgb(struct job * j) { return MISS(pixelsearch5x(j->hay, END(j), COLOR, DISTANCE_RGB, RGB_DISTANCE), j); }
+static void * k_pixelsearch5x_redmean(struct job * j) { return MISS(pixelsearch5x(j->hay, END(j), COLOR, DISTANCE_REDMEAN, RGB_DISTANCE), j); }
+static void * k_pixelsearch5x_lab(struct job * j) { return MISS(pixelsearch5x(j->hay, END(j), COLOR, DISTANCE_LAB, LAB_DISTANCE), j); }
+
+static void * k_pixelsearchall1(struct job * j) { return pixelsearchall1(j->results, RESULTS, j->hay, END(j), COLOR) ? j->results[0] : 0; }
+static void * k_pixelsearchall1x(struct job * j) { return pixelsearchall1x(j->results, RESULTS, j->hay, END(j), COLOR) ? j->results[0] : 0; }
+static void * k_pixelsearchall2(struct job * j) {
+    return pixelsearchall2(j->results, RESULTS, j->hay, END(j), RANGE(COLOR, j->variation, 16), RANGE(COLOR, j->variation, 8), RANGE(COLOR, j->variation, 0)) ? j->results[0] : 0;
+}
+static void * k_pixelsearchall2x(struct job * j) {
+    return pixelsearchall2x(j->results, RESULTS, j->hay, END(j), RANGE(COLOR, j->variation, 16), RANGE(COLOR, j->variation, 8), RANGE(COLOR, j->variation, 0)) ? j->results[0] : 0;
+}
+static void * k_pixelsearchall3(struct job * j) { return pixelsearchall3(j->results, RESULTS, j->hay, END(j), colors, 4) ? j->results[0] : 0; }
+static void * k_pixelsearchall3x(struct job * j) { return pixelsearchall3x(j->results, RESULTS, j->hay, END(j), colors, 4) ? j->results[0] : 0; }
+static void * k_pixelsearchall4(struct job * j) { return pixelsearchall4(j->results, RESULTS, j->hay, END(j), highs, lows, 4) ? j->results[0] : 0; }
+static void * k_pixelsearchall4x(struct job * j) { return pixelsearchall4x(j->results, RESULTS, j->hay, END(j), highs, lows, 4) ? j->results[0] : 0; }
+
+static void * k_pixelsearchall5x_rgb(struct job * j) { return pixelsearchall5x(j->results, RESULTS, j->hay, END(j), COLOR, DISTANCE_RGB, RGB_DISTANCE) ? j->results[0] : 0; }
+static void * k_pixelsearchall5x_lab(struct job * j) { return pixelsearchall5x(j->results, RESULTS, j->hay, END(j), COLOR, DISTANCE_LAB, LAB_DISTANCE) ? j->results[0] : 0; }
+
+static void * k_imagesearch1(struct job * j) {
+    return imagesearch1(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, 0);
+}
+static void * k_imagesearch2(struct job * j) {
+    return imagesearch2(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, j->variation, 0);
+}
+
+// The same searches with counters, to measure what instrumentation costs.
+static struct imagesearch_stats stats;
+static void * k_imagesearch1_stats(struct job * j) {
+    return imagesearch1(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, &stats);
+}
+static void * k_imagesearch2_stats(struct job * j) {
+    return imagesearch2(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, j->variation, &stats);
+}
+static void * k_imagesearch(struct job * j) {
+    return imagesearch(j->results, RESULTS, j->hay, j->width, j->height, j->needle, j->w, j->h) ? j->results[0] : 0;
+}
+static void * k_imagesearch5_rgb(struct job * j) {
+    return imagesearch5(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, DISTANCE_RGB, RGB_DISTANCE, 0);
+}
+static void * k_imagesearch5_lab(struct job * j) {
+    return imagesearch5(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, DISTANCE_LAB, LAB_DISTANCE, 0);
+}
+static unsigned int columns[7681];
+static void * k_imagesearch4(struct job * j) {
+    return imagesearch4(j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, columns, 0);
+}
+static void * k_imagesearchall1(struct job * j) {
+    return imagesearchall1(j->results, RESULTS, j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2) ? j->results[0] : 0;
+}
+static void * k_imagesearchall4(struct job * j) {
+    return imagesearchall4(j->results, RESULTS, j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, columns) ? j->results[0] : 0;
+}
+static void * k_imagesearchall2(struct job * j) {
+    return imagesearchall2(j->results, RESULTS, j->hay, j->width, j->height, 4 * j->width, j->needle, j->w, j->h, 4 * j->w, j->w / 2, j->h / 2, j->variation) ? j->results[0] : 0;
+}
+
+// Indexed searches run on a plane of palette indices in work, made after the match is planted.
+// Haystacks with more than 255 colors cannot be indexed and are skipped.
+static unsigned int palette_colors[256], palette_table[PALETTE_SLOTS], palette_count;
+static unsigned char needle_plane[128 * 128], palette_slot;
+static void * k_palette(struct job * j) {
+    memset(palette_table, 0, sizeof(palette_table));
+    palette_count = palette(j->hay, j->width, j->height, 4 * j->width, j->work, palette_colors, palette_table, 0, 0);
+    return palette_count > 255 ? (void *) -1 : 0;
+}
+static void * prepare_pixelsearch1b(struct job * j) {
+    if (k_palette(j))
+        return (void *) -1;
+    palette_slot = 255; // Never in a haystack plane, so a missing color is still searched for.
+    for (unsigned int i = 0; i < palette_count; i++)
+        if (palette_colors[i] == COLOR)
+            palette_slot = i;
+    return 0;
+}
+static void * prepare_imagesearch1b(struct job * j) {
+    if (k_palette(j))
+        return (void *) -1;
+    return palette(j->needle, j->w, j->h, 4 * j->w, needle_plane, palette_colors, palette_table, palette_count, 1) > 255 ? (void *) -1 : 0;
+}
+static void * k_pixelsearch1b(struct job * j) {
+    unsigned char * p = pixelsearch1b(j->work, j->work + (size_t) j->width * j->height, palette_slot);
+    return MISS(j->hay + (p - j->work), j);
+}
+static void * k_imagesearch1b(struct job * j) {
+    unsigned char * p = imagesearch1b(j->work, j->width, j->height, needle_plane, j->w, j->h, j->w / 2, j->h / 2, 0);
+    return p ? j->hay + (p - j->work) : 0;
+}
+
+// Equal images are compared to the end. scratch holds the copy.
+static void * prepare_bitmapequal(struct job * j) {
+    memcpy(j->scratch, j->hay, (size_t) 4 * j->width * j->height);
+    return 0;
+}
+static void * k_bitmapequal(struct job * j) {
+    return (void *) (size_t) (bitmapequal(j->hay, j->scratch, j->width, j->height, 4 * j->width, 4 * j->width) != j->width * j->height);
+}
+static void * k_pixelhash(struct job * j) { return (void *) (size_t) (pixelhash(j->hay, j->width, j->height, 4 * j->width) == 0); }
+static void * k_phash_average(struct job * j) { return (void *) (size_t) (phash(j->hay, j->width, j->height, 4 * j->width, PHASH_AVERAGE) == 1); }
+static void * k_phash_dct(struct job * j) { return (void *) (size_t) (phash(j->hay, j->width, j->height, 4 * j->width, PHASH_DCT) == 1); }
+
+// Sums and squares in one band. The tables are 64 bytes per pixel, more than work holds.
+static unsigned long long * integral_tables;
+static void * prepare_integral(struct job * j) {
+    free(integral_tables);
+    integral_tables = aligned_alloc(64, (size_t) 64 * (j->width + 1) * (j->height + 1));
+    return integral_tables ? 0 : (void *) -1;
+}
+static void * k_integral(struct job * j) {
+    size_t entries = (size_t) (j->width + 1) * (j->height + 1);
+    struct integral r = {.pixels = j->hay, .sums = integral_tables, .squares = integral_tables + 4 * entries,
+                         .width = j->width, .height = j->height, .stride = 4 * j->width,
+                         .bands = 1, .pass = 1, .first = 0, .last = j->height};
+    integral(&r);
+    return 0;
+}
+
+// RGB out to work, as the bytes of an interleaved image or as normalized floats in planes.
+static void * k_pack_bytes(struct job * j) {
+    struct pack r = {j->hay, j->work, {0}, {0}, j->width, j->height, 4 * j->width, 3, {2, 1, 0}, 0, 0, 0, 0, j->height};
+    return (void *) (size_t) pack(&r);
+}
+static void * k_pack_floats(struct job * j) {
+    struct pack r = {j->hay, j->work, {1 / 255.0f, 1 / 255.0f, 1 / 255.0f}, {0}, j->width, j->height, 4 * j->width, 3, {2, 1, 0}, 1, 1, 0, 0, j->height};
+    return (void *) (size_t) pack(&r);
+}
+
+// Turned into scratch, and flipped back and forth in place.
+static void * k_rotate(struct job * j) {
+    struct rotate r = {j->hay, j->scratch, j->width, j->height, 4 * j->width, 4 * j->height, 6, 0, j->width};
+    return (void *) (size_t) rotate(&r);
+}
+static void * k_flip(struct job * j) {
+    struct rotate r = {j->scratch, j->scratch, j->width, j->height, 4 * j->width, 4 * j->width, 2, 0, j->height};
+    return (void *) (size_t) rotate(&r);
+}
+
+// The haystack drawn over scratch, whatever scratch holds from the runs before.
+static void * k_composite_over(struct job * j) {
+    struct composite r = {j->scratch, j->hay, j->width, j->height, 4 * j->width, 4 * j->width, 255, 0, 0, 0, j->height};
+    return (void *) (size_t) composite(&r);
+}
+static void * k_composite_half(struct job * j) {
+    struct composite r = {j->scratch, j->hay, j->width, j->height, 4 * j->width, 4 * j->width, 128, 0, 0, 0, j->height};
+    return (void *) (size_t) composite(&r);
+}
+static void * k_composite_screen(struct job * j) {
+    struct composite r = {j->scratch, j->hay, j->width, j->height, 4 * j->width, 4 * j->width, 128, 1, 2, 0, j->height};
+    return (void *) (size_t) composite(&r);
+}
+
+// Transforms work on a copy of the haystack, so every run sees the same pixels.
+static void copy_hay(struct job * j) {
+    memcpy(j->scratch, j->hay, (size_t) 4 * j->width * j->height);
+}
+#define SCRATCH_END(j) ((j)->scratch + (size_t) (j)->width * (j)->height)
+static void * k_checkalpha(struct job * j) { return (void *) (size_t) checkalpha(j->hay, END(j)); }
+static void * k_colorkey(struct job * j) { copy_hay(j); colorkey(j->scratch, SCRATCH_END(j), SOLID, 0); return 0; }
+static void * k_from_sprite(struct job * j) { copy_hay(j); from_sprite(j->scratch, SCRATCH_END(j), SOLID); return 0; }
+static void * k_setalpha(struct job * j) { copy_hay(j); setalpha(j->scratch, SCRATCH_END(j), 0x80); return 0; }
+static void * k_transcolor(struct job * j) { copy_hay(j); transcolor(j->scratch, SCRATCH_END(j), SOLID, 0x40); return 0; }
+
+// Decoders read what the matching encoder left in work, and return the size written to scratch.
+static ptrdiff_t encoded;
+static void * k_hex_encode(struct job * j) { return (void *) (encoded = hex(0, j->hay, (size_t) 4 * j->width * j->height, j->work, 1)); }
+static void * k_hex_decode(struct job * j) { return (void *) hex(1, j->work, encoded, j->scratch, 0); }
+static void * k_base64_encode(struct job * j) { return (void *) (encoded = base64(0, j->hay, (size_t) 4 * j->width * j->height, j->work, 0)); }
+static void * k_base64_decode(struct job * j) { return (void *) base64(1, j->work, encoded, j->scratch, 0); }
+static void * k_qoi_encode(struct job * j) { return (void *) (encoded = qoi(0, j->hay, j->width, j->height, 4 * j->width, j->work, 0)); }
+static void * k_qoi_decode(struct job * j) { return (void *) qoi(1, j->scratch, j->width, j->height, 4 * j->width, j->work, encoded); }
+
+static void * k_png(struct job * j) {
+    static unsigned int crc_table[8 * 256];
+    struct png setup = {.pixels = (unsigned char *) j->hay, .crc = crc_table, .width = j->width, .height = j->height, .stride = 4 * j->width, .level = 2};
+    png(&setup);
+    // Filtered rows, then the deflate stream, then the hash tables and scratch rows.
+    size_t raw = (size_t) j->height * (1 + 4 * j->width);
+    struct png band = setup;
+    band.filtered = j->work;
+    band.out = j->work + raw;
+    band.work = band.out + raw + raw / 2048 + 64;
+    band.pass = 1;
+    band.first = 0;
+    band.last = j->height;
+    png(&band);
+    return (void *) (size_t) band.size;
+}
+
+static void * k_resample(struct job * j) {
+    // Bicubic to half size, single threaded: weights, then the horizontal and vertical passes.
+    struct resample r = {.src = j->hay, .dst = j->scratch, .sw = j->width, .sh = j->height, .sstride = 4 * j->width,
+        .dw = j->width / 2, .dh = j->height / 2, .dstride = 4 * (j->width / 2), .filter = 2};
+    resample(&r);
+    short * tables = (short *) j->work;
+    r.tmp = tables;
+    r.xbounds = (int *) (tables + (size_t) 4 * r.dw * r.sh);
+    r.xweights = (short *) (r.xbounds + r.dw);
+    r.ybounds = (int *) (r.xweights + r.xtaps * r.dw + 8);
+    r.yweights = (short *) (r.ybounds + r.dh);
+    resample(&r);
+    r.pass = 1, r.first = 0, r.last = r.sh;
+    resample(&r);
+    r.pass = 2, r.first = 0, r.last = r.dh;
+    resample(&r);
+    return 0;
+}
+
+struct kernel {
+    const char * name;
+    kernel_t run;
+    kernel_t prepare;                // Run once before timing, after any match is planted. (void *) -1 skips the case.
+    int kind;                        // 0 = pixel search, 1 = color list, 2 = image search, 3 = whole image
+    int variations;                  // Takes a variation
+};
+
+static const struct kernel kernels[] = {
+    {"pixelsearch1", k_pixelsearch1, 0, 0, 0},
+    {"pixelsearch1x", k_pixelsearch1x, 0, 0, 0},
+    {"pixelsearch1x2", k_pixelsearch1x2, 0, 0, 0},
+    {"pixelsearch1y", k_pixelsearch1y, 0, 0, 0},
+    {"pixelsearch1b", k_pixelsearch1b, prepare_pixelsearch1b, 0, 0},
+    {"pixelsearch2", k_pixelsearch2, 0, 0, 1},
+    {"pixelsearch2x", k_pixelsearch2x, 0, 0, 1},
+    {"pixelsearch3", k_pixelsearch3, 0, 1, 0},
+    {"pixelsearch3x", k_pixelsearch3x, 0, 1, 0},
+    {"pixelsearch4", k_pixelsearch4, 0, 1, 1},
+    {"pixelsearch4x", k_pixelsearch4x, 0, 1, 1},
+    {"pixelsearch5x/rgb", k_pixelsearch5x_rgb, 0, 0, 0},
+    {"pixelsearch5x/redmean", k_pixelsearch5x_redmean, 0, 0, 0},
+    {"pixelsearch5x/lab", k_pixelsearch5x_lab, 0, 0, 0},
+    {"pixelsearchall1", k_pixelsearchall1, 0, 0, 0},
+    {"pixelsearchall1x", k_pixelsearchall1x, 0, 0, 0},
+    {"pixelsearchall2", k_pixelsearchall2, 0, 0, 1},
+    {"pixelsearchall2x", k_pixelsearchall2x, 0, 0, 1},
+    {"pixelsearchall3", k_pixelsearchall3, 0, 1, 0},
+    {"pixelsearchall3x", k_pixelsearchall3x, 0, 1, 0},
+    {"pixelsearchall4", k_pixelsearchall4, 0, 1, 1},
+    {"pixelsearchall4x", k_pixelsearchall4x, 0, 1, 1},
+    {"pixelsearchall5x/rgb", k_pixelsearchall5x_rgb, 0, 0, 0},
+    {"pixelsearchall5x/lab", k_pixelsearchall5x_lab, 0, 0, 0},
+    {"imagesearch1", k_imagesearch1, 0, 2, 0},
+    {"imagesearch2", k_imagesearch2, 0, 2, 1},
+    {"imagesearch1/stats", k_imagesearch1_stats, 0, 2, 0},
+    {"imagesearch2/stats", k_imagesearch2_stats, 0, 2, 1},
+    {"imagesearch5/rgb", k_imagesearch5_rgb, 0, 2, 0},
+    {"imagesearch5/lab", k_imagesearch5_lab, 0, 2, 0},
+    {"imagesearch4", k_imagesearch4, 0, 2, 0},
+    {"imagesearch1b", k_imagesearch1b, prepare_imagesearch1b, 2, 0},
+    {"imagesearch", k_imagesearch, 0, 2, 0},
+    {"imagesearchall1", k_imagesearchall1, 0, 2, 0},
+    {"imagesearchall4", k_imagesearchall4, 0, 2, 0},
+    {"imagesearchall2", k_imagesearchall2, 0, 2, 1},
+    {"palette", k_palette, k_palette, 3, 0},
+    {"bitmapequal", k_bitmapequal, prepare_bitmapequal, 3, 0},
+    {"pixelhash", k_pixelhash, 0, 3, 0},
+    {"phash/average", k_phash_average, 0, 3, 0},
+    {"phash/dct", k_phash_dct, 0, 3, 0},
+    {"integral", k_integral, prepare_integral, 3, 0},
+    {"pack/rgb-bytes", k_pack_bytes, 0, 3, 0},
+    {"pack/rgb-floats-planar", k_pack_floats, 0, 3, 0},
+    {"rotate/90", k_rotate, 0, 3, 0},
+    {"rotate/flip", k_flip, 0, 3, 0},
+    {"composite/over", k_composite_over, 0, 3, 0},
+    {"composite/over-half", k_composite_half, 0, 3, 0},
+    {"composite/screen-premultiplied", k_composite_screen, 0, 3, 0},
+    {"checkalpha", k_checkalpha, 0, 3, 0},
+    {"colorkey", k_colorkey, 0, 3, 0},
+    {"from_sprite", k_from_sprite, 0, 3, 0},
+    {"setalpha", k_setalpha, 0, 3, 0},
+    {"transcolor", k_transcolor, 0, 3, 0},
+    {"hex/encode", k_hex_encode, 0, 3, 0},
+    {"hex/decode", k_hex_decode, k_hex_encode, 3, 0},
+    {"base64/encode", k_base64_encode, 0, 3, 0},
+    {"base64/decode", k_base64_decode, k_base64_encode, 3, 0},
+    {"png/fast", k_png, 0, 3, 0},
+    {"qoi/encode", k_qoi_encode, 0, 3, 0},
+    {"qoi/decode", k_qoi_decode, k_qoi_encode, 3, 0},
+    {"resample/bicubic-half", k_resample, 0, 3, 0},
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Runs until at least 0.2 s or 10 runs have passed, at least twice, and keeps the fastest run.
+static void measure(const struct kernel * k, struct job * j, const char * haystack, const char * needle, const char * hit, const char * variation, size_t visited, void * expect) {
+    double best = 1e30, start = now();
+    unsigned long long ticks = 0;
+    int failed = 0;
+    for (int runs = 0; runs < 2 || (runs < 10 && now() - start < 0.2); runs++) {
+        double t0 = now();
+        unsigned long long c0 = __rdtsc();
+        void * got = k->run(j);
+        unsigned long long c1 = __rdtsc();
+        double t = now() - t0;
+        if (t < best)
+            best = t, ticks = c1 - c0;
+        failed |= (expect != (void *) -1) && got != expect;
+    }
+    printf("%s\t%s\t%ux%u\t%s\t%s\t%s\t%zu\t%.3f\t%.2f\t%.3f\t%.3f%s\n", k->name, haystack, j->width, j->height, needle, hit, variation,
+        visited, best * 1e3, visited * 4 / best / 1e9, best * 1e9 / visited, (double) ticks / visited, failed ? "\t# wrong result" : "");
+    fflush(stdout);
+}
+
+int main(int argc, char ** argv) {
+    static const unsigned int sizes[][2] = {{1920, 1080}, {3840, 2160}, {7680, 4320}};
+    static const unsigned int needles[] = {8, 32, 128};
+    static const unsigned int variations[] = {0, 16};
+    const char * filter = "";
+    int quick = 0;
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--quick"))
+            quick = 1;
+        else
+            filter = argv[i];
+
+    for (int i = 0; i < 4; i++)
+        highs[i] = colors[i] | 0x00101010, lows[i] = colors[i] & 0xFFEFEFEF;
+
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    printf("# avx2 %s\n", avx2 ? "yes" : "no");
+    printf("kernel\thaystack\tsize\tneedle\thit\tvariation\tpixels\tms\tGB/s\tns/px\tcycles/px\n");
+
+    for (size_t s = 0; s < (quick ? 1 : sizeof(sizes) / sizeof(*sizes)); s++) {
+        struct job j = {0};
+        j.width = sizes[s][0], j.height = sizes[s][1];
+        size_t n = (size_t) j.width * j.height;
+        j.hay = malloc(4 * n);
+        j.scratch = malloc(4 * n);
+        j.work = malloc(16 * n + (1 << 20)); // Hex is 2 characters of 2 bytes for every byte
+        j.needle = malloc(4 * 128 * 128);
+        j.results = malloc(RESULTS * sizeof(*j.results));
+        j.saved = malloc(4 * 128 * 128);
+
+        for (int kind = 0; kind < HAYSTACKS; kind++) {
+            make_haystack(j.hay, j.width, j.height, kind);
+            for (size_t k = 0; k < sizeof(kernels) / sizeof(*kernels); k++) {
+                const struct kernel * kernel = kernels + k;
+                if (!strstr(kernel->name, filter) || (!avx2 && kernel->run == k_pixelsearch1y))
+                    continue;
+
+                // Whole image kernels ignore hits and needles.
+                if (kernel->kind == 3) {
+                    if (kernel->prepare && kernel->prepare(&j) == (void *) -1)
+                        continue;
+                    measure(kernel, &j, haystack_names[kind], "-", "-", "-", n, (void *) -1);
+                    continue;
+                }
+
+                for (size_t v = 0; v < (kernel->variations ? 2 : 1); v++) {
+                    char variation[16] = "-";
+                    j.variation = kernel->variations ? variations[v] : 0;
+                    set_ranges(j.variation);
+                    if (kernel->variations)
+                        snprintf(variation, sizeof variation, "%u", j.variation);
+
+                    if (kernel->kind == 0 || kernel->kind == 1) {
+                        for (int hit = 0; hit < HITS; hit++) {
+                            size_t visited = plant(&j, hit, 0, 0);
+                            if (kernel->prepare && kernel->prepare(&j) == (void *) -1) {
+                                plant(&j, hit, 0, 1);
+                                continue;
+                            }
+                            // Search all kernels always visit every pixel.
+                            size_t total = strstr(kernel->name, "all") ? n : visited;
+                            void * expect = (hit == HIT_NONE) ? 0 : j.hay + visited - 1;
+                            measure(kernel, &j, haystack_names[kind], kernel->kind ? "4" : "1", hit_names[hit], variation, total, expect);
+                            plant(&j, hit, 0, 1);
+                        }
+                        continue;
+                    }
+
+                    for (size_t w = 0; w < sizeof(needles) / sizeof(*needles); w++) {
+                        char needle[16];
+                        j.w = j.h = needles[w];
+                        snprintf(needle, sizeof needle, "%ux%u", j.w, j.h);
+                        make_needle(&j, kind);
+                        for (int hit = 0; hit < HITS; hit++) {
+                            // Near misses are expensive to search, so large needles skip the largest haystacks.
+                            if (kind == NEARMISS_HAY && j.w == 128 && s > 0)
+                                continue;
+                            size_t visited = plant(&j, hit, 1, 0);
+                            if (kernel->prepare && kernel->prepare(&j) == (void *) -1) {
+                                plant(&j, hit, 1, 1);
+                                continue;
+                            }
+                            size_t total = strstr(kernel->name, "all") || kernel->run == k_imagesearch ? n : visited;
+                            void * expect = (hit == HIT_NONE) ? 0 : j.hay + visited - 1;
+                            if (kernel->run == k_imagesearch && hit == HIT_END)
+                                expect = (void *) -1; // imagesearch3.c does not search the last row of positions.
+                            measure(kernel, &j, haystack_names[kind], needle, hit_names[hit], variation, total, expect);
+                            plant(&j, hit, 1, 1);
+                        }
+                    }
+                }
+            }
+        }
+        free(j.hay), free(j.scratch), free(j.work), free(j.needle), free(j.results), free(j.saved);
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+// One writer process and several reader processes sharing source/channel.c through POSIX shared memory.
+// Build and run on Linux: gcc -O2 test/native/channel.c -o channel -lrt && ./channel
+// shm_open stands in for a named CreateFileMapping. Every pixel of a frame is derived from its frame number,
+// so a reader that keeps a torn or recycled frame is detected. Readers must also see frame numbers increase.
+// Frames are 1080p so that copies are long enough to be interrupted by the writer, even on a single core.
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../../source/channel.c"
+
+#define WIDTH   1920
+#define HEIGHT  1080
+#define FRAMES  200
+#define READERS 3
+
+struct result {
+    unsigned int snapshots, torn, backwards, last;
+};
+
+static unsigned int pixel(unsigned int frame, unsigned int i) {
+    return frame * 0x9E3779B1u ^ i;
+}
+
+static void reader(struct channel * c, struct result * r) {
+    static unsigned int frame[WIDTH * HEIGHT];
+    channel(c, 2, 0, 0, 0);
+    unsigned int since = 0;
+    while (since != FRAMES) {
+        unsigned int n = channel(c, 1, (unsigned char *) frame, 4 * WIDTH, since);
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+        for (unsigned int i = 0; i < WIDTH * HEIGHT; i++)
+            r->torn += frame[i] != pixel(n, i);
+        r->backwards += n <= since;
+        r->snapshots++;
+        since = n;
+    }
+    r->last = since;
+    channel(c, 3, 0, 0, 0);
+}
+
+static int run(unsigned int slots) {
+    // The writer creates and sizes the channel, like ImagePut.FrameChannel.
+    char name[64];
+    snprintf(name, sizeof name, "/imageput-channel-%d-%u", (int) getpid(), slots);
+    unsigned int stride = (4 * WIDTH + 63) & ~63u, header = 64 + 64 * slots;
+    size_t size = header + (size_t) slots * stride * HEIGHT;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, size) != 0)
+        return 0;
+    struct channel * c = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    *c = (struct channel) {.magic = CHANNEL_MAGIC, .header = header, .width = WIDTH, .height = HEIGHT,
+        .stride = stride, .format = 0x26200A, .slots = slots, .size = stride * HEIGHT};
+
+    struct result * results = mmap(0, READERS * sizeof(struct result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(results, 0, READERS * sizeof(struct result));
+
+    // Each reader opens the channel by name and maps it at its own address.
+    pid_t pids[READERS];
+    for (int k = 0; k < READERS; k++)
+        if ((pids[k] = fork()) == 0) {
+            int rfd = shm_open(name, O_RDWR, 0);
+            struct channel * view = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, rfd, 0);
+            close(rfd);
+            reader(view, results + k);
+            _exit(0);
+        }
+    while (__atomic_load_n(&c->readers, __ATOMIC_RELAXED) != READERS)
+        sched_yield();
+
+    static unsigned int frame[WIDTH * HEIGHT];
+    unsigned int failures = 0;
+    for (unsigned int n = 1; n <= FRAMES; n++) {
+        for (unsigned int i = 0; i < WIDTH * HEIGHT; i++)
+            frame[i] = pixel(n, i);
+        failures += channel(c, 0, (unsigned char *) frame, 4 * WIDTH, 0) != n;
+        if (n % 4 == 0)
+            sched_yield(); // Let the readers run some of the time.
+    }
+    for (int k = 0; k < READERS; k++)
+        waitpid(pids[k], 0, 0);
+    failures += c->readers != 0;
+
+    for (int k = 0; k < READERS; k++) {
+        struct result * r = results + k;
+        failures += r->torn + r->backwards + (r->last != FRAMES);
+        printf("%s slots %u, reader %d: %u snapshots, %u torn pixels, %u out of order\n",
+            (r->torn || r->backwards || r->last != FRAMES) ? "FAIL" : "PASS", slots, k, r->snapshots, r->torn, r->backwards);
+    }
+
+    munmap(results, READERS * sizeof(struct result));
+    munmap(c, size);
+    shm_unlink(name);
+    return failures == 0;
+}
+
+int main(void) {
+    int ok = 1;
+    for (unsigned int slots = 2; slots <= 4; slots++)
+        ok &= run(slots);
+    printf("%s channel\n", ok ? "PASS" : "FAIL");
+    return !ok;
+}
@@ -0,0 +1,92 @@
+// Alpha compositing in source/composite.c.
+// Build and run on Linux: gcc -O2 test/native/composite.c -o composite && ./composite
+// Every mode, with and without premultiplied alpha, is checked against the formulas computed one channel at a
+// time, on rectangles with padding, in random bands of rows. Nothing outside the rectangle may change.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/composite.c"
+#include "test.h"
+
+static unsigned int times(unsigned int a, unsigned int b) {
+    return (a * b + 127) / 255;
+}
+
+static unsigned int channel(unsigned int p, int k) {
+    return p >> (8 * k) & 0xFF;
+}
+
+static unsigned int reference(unsigned int s, unsigned int d, unsigned int opacity, unsigned int premultiplied, unsigned int mode) {
+    unsigned int sp[4], dp[4], x[4], out = 0;
+    unsigned int sa = times(channel(s, 3), opacity), da = channel(d, 3);
+    if (!premultiplied && sa == 0)
+        return d;
+
+    // Premultiply, with the alpha scaled by opacity.
+    for (int k = 0; k < 4; k++) {
+        sp[k] = premultiplied ? times(channel(s, k), opacity) : (k == 3) ? sa : times(channel(s, k), sa);
+        dp[k] = (premultiplied || k == 3) ? channel(d, k) : times(channel(d, k), da);
+    }
+    sa = sp[3];
+
+    for (int k = 0; k < 4; k++) {
+        switch (mode) {
+            case 0: x[k] = sp[k] + times(dp[k], 255 - sa); break;
+            case 1: x[k] = times(sp[k], dp[k]) + times(sp[k], 255 - da) + times(dp[k], 255 - sa); break;
+            case 2: x[k] = sp[k] + dp[k] - times(sp[k], dp[k]); break;
+            case 3: x[k] = sp[k] + dp[k]; break;
+        }
+        x[k] = x[k] > 255 ? 255 : x[k];
+    }
+
+    // Divide by alpha again, rounded to the nearest.
+    for (int k = 0; k < 4; k++) {
+        unsigned int c = x[k];
+        if (!premultiplied && k < 3) {
+            c = x[3] ? (x[k] * 255 + x[3] / 2) / x[3] : 0;
+            c = c > 255 ? 255 : c;
+        }
+        out |= c << (8 * k);
+    }
+    return out;
+}
+
+static unsigned int pixel(int t) {
+    // Mostly opaque and transparent pixels, so the shortcuts are taken, between pixels of any alpha.
+    unsigned int p = next();
+    switch (next() % 4) {
+        case 0: return p | 0xFF000000;
+        case 1: return (t % 2) ? p & 0x00FFFFFF : 0;
+        default: return p;
+    }
+}
+
+int main(void) {
+    static unsigned int src[40 * 40], dst[40 * 40], expect[40 * 40];
+    int failures = 0;
+
+    for (int t = 0; t < 40000; t++) {
+        unsigned int width = 1 + next() % 32, height = 1 + next() % 32;
+        unsigned int sstride = width + next() % 6, dstride = width + next() % 6;
+        unsigned int opacity = (next() % 2) ? 255 : next() % 256;
+        for (unsigned int i = 0; i < 40 * 40; i++)
+            src[i] = pixel(t), dst[i] = pixel(t);
+
+        struct composite r = {.dst = dst, .src = src, .width = width, .height = height, .dstride = 4 * dstride,
+                              .sstride = 4 * sstride, .opacity = opacity, .premultiplied = next() % 2, .mode = next() % 4};
+        memcpy(expect, dst, sizeof(dst));
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++)
+                expect[y * dstride + x] = reference(src[y * sstride + x], dst[y * dstride + x], opacity, r.premultiplied, r.mode);
+
+        BANDS(composite, &r, height);
+
+        if (memcmp(dst, expect, sizeof(dst)) != 0 && failures++ < 5)
+            printf("composite case %d: %ux%u, opacity %u, %s, mode %u\n", t, width, height, opacity,
+                r.premultiplied ? "premultiplied" : "straight", r.mode);
+    }
+
+    printf("%s composite: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,351 @@
+// Differential tests of the SIMD kernels in source/ against their scalar twins and a plain reference.
+// Build and run on Linux: gcc -O2 test/native/differential.c -o differential && ./differential [cases] [seed]
+// Every case draws a random size, position, stride, palette, color list, variation, and result limit.
+// Haystacks are placed against an inaccessible page, alternating between the page after the end and
+// the page before the start, so a kernel that reads past either edge crashes instead of passing.
+// Colors come from a small palette, so matches are dense and runs of the same color are common.
+// Search all kernels may report results in a different order, so their results are compared as sets.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../source/pixelsearch1.c"
+#include "../../source/pixelsearch1x.c"
+#include "../../source/pixelsearch1x2.c"
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include "../../source/pixelsearch1y.c"
+#pragma GCC pop_options
+#include "../../source/pixelsearch2.c"
+#include "../../source/pixelsearch2x.c"
+#include "../../source/pixelsearch3.c"
+#include "../../source/pixelsearch3x.c"
+#include "../../source/pixelsearch4.c"
+#include "../../source/pixelsearch4x.c"
+#include "../../source/pixelsearchall1.c"
+#include "../../source/pixelsearchall1x.c"
+#include "../../source/pixelsearchall2.c"
+#include "../../source/pixelsearchall2x.c"
+#include "../../source/pixelsearchall3.c"
+#include "../../source/pixelsearchall3x.c"
+#include "../../source/pixelsearchall4.c"
+#include "../../source/pixelsearchall4x.c"
+#include "../../source/imagesearch1.c"
+#include "../../source/imagesearch2.c"
+#include "../../source/imagesearchall1.c"
+#include "../../source/imagesearch4.c"
+#include "../../source/imagesearchall4.c"
+#define within imagesearchall2_within
+#include "../../source/imagesearchall2.c"
+#undef within
+#include "test.h"
+
+#define MAX_PIXELS 4096
+#define LIMIT 64
+
+static unsigned int failures, tested, case_seed;
+static unsigned long long current_case;
+
+// Failures are counted per kernel and problem. The first few are printed with the seed of their case.
+// Rerun one with: ./differential 1 <seed>
+static struct {
+    const char * kernel, * what;
+    unsigned int count;
+} tally[64];
+
+static void fail(const char * kernel, const char * what) {
+    if (failures++ < 20)
+        printf("FAIL case %llu (seed %u): %s %s\n", current_case, case_seed, kernel, what);
+    for (int i = 0; i < 64; i++)
+        if (!tally[i].kernel || (!strcmp(tally[i].kernel, kernel) && !strcmp(tally[i].what, what))) {
+            tally[i].kernel = kernel, tally[i].what = what, tally[i].count++;
+            break;
+        }
+}
+
+// Guarded memory: pixels either end at an inaccessible page or start right after one.
+static unsigned char * region;
+static size_t page;
+
+static unsigned int * guarded(size_t n, int at_end) {
+    size_t bytes = (4 * n + page - 1) / page * page;
+    unsigned char * body = region + page; // region = guard, body (up to 6 pages), guard
+    mprotect(body, 7 * page, PROT_READ | PROT_WRITE);
+    if (at_end) {
+        mprotect(body + bytes, page, PROT_NONE);
+        return (unsigned int *) (body + bytes) - n;
+    }
+    return (unsigned int *) body;
+}
+
+// ---------------------------------------------------------------------------- Reference predicates
+
+static int in_range(unsigned int c, unsigned int high, unsigned int low) {
+    for (int k = 0; k < 24; k += 8)
+        if ((c >> k & 0xFF) > (high >> k & 0xFF) || (c >> k & 0xFF) < (low >> k & 0xFF))
+            return 0;
+    return 1;
+}
+
+struct query {
+    unsigned int color, high, low;
+    unsigned int colors[8], highs[8], lows[8], length;
+};
+
+static int match(const struct query * q, int kind, unsigned int c) {
+    if (kind == 1) return c == q->color;
+    if (kind == 2) return in_range(c, q->high, q->low);
+    for (unsigned int i = 0; i < q->length; i++)
+        if ((kind == 3) ? c == q->colors[i] : in_range(c, q->highs[i], q->lows[i]))
+            return 1;
+    return 0;
+}
+
+#define CH(c, k) ((unsigned char) ((c) >> (k)))
+
+// Runs every variant of one kind on the same haystack.
+static void pixelsearch_case(unsigned int * start, unsigned int * end, const struct query * q, int kind, int avx2) {
+    unsigned int * expect = start;
+    unsigned int all[MAX_PIXELS], count = 0;
+    for (unsigned int * p = start; p < end; p++)
+        if (match(q, kind, *p)) {
+            if (count == 0)
+                expect = p;
+            all[count++] = (unsigned int) (p - start);
+        }
+    if (count == 0)
+        expect = end;
+
+    unsigned int * got[4] = {0};
+    const char * names[4] = {0};
+    int n = 0;
+    unsigned int rh = CH(q->high, 16), rl = CH(q->low, 16), gh = CH(q->high, 8), gl = CH(q->low, 8), bh = CH(q->high, 0), bl = CH(q->low, 0);
+    switch (kind) {
+        case 1:
+            names[n] = "pixelsearch1", got[n++] = pixelsearch1(start, end, q->color);
+            names[n] = "pixelsearch1x", got[n++] = pixelsearch1x(start, end, q->color);
+            names[n] = "pixelsearch1x2", got[n++] = pixelsearch1x2(start, end, q->color);
+            if (avx2)
+                names[n] = "pixelsearch1y", got[n++] = pixelsearch1y(start, end, q->color);
+            break;
+        case 2:
+            names[n] = "pixelsearch2", got[n++] = pixelsearch2(start, end, rh, rl, gh, gl, bh, bl);
+            names[n] = "pixelsearch2x", got[n++] = pixelsearch2x(start, end, rh, rl, gh, gl, bh, bl);
+            break;
+        case 3:
+            names[n] = "pixelsearch3", got[n++] = pixelsearch3(start, end, (unsigned int *) q->colors, q->length);
+            names[n] = "pixelsearch3x", got[n++] = pixelsearch3x(start, end, (unsigned int *) q->colors, q->length);
+            break;
+        case 4:
+            names[n] = "pixelsearch4", got[n++] = pixelsearch4(start, end, (unsigned int *) q->highs, (unsigned int *) q->lows, q->length);
+            names[n] = "pixelsearch4x", got[n++] = pixelsearch4x(start, end, (unsigned int *) q->highs, (unsigned int *) q->lows, q->length);
+            break;
+    }
+    for (int i = 0; i < n; i++, tested++)
+        if (got[i] != expect)
+            fail(names[i], "returned a different first match");
+
+    // Search all: the count, and the reported positions as a set.
+    unsigned int limit = next() % (count + 3);
+    if (limit > LIMIT)
+        limit = LIMIT;
+    for (int variant = 0; variant < 2; variant++, tested++) {
+        unsigned int * result[LIMIT + 1];
+        unsigned int c = 0;
+        const char * name = "";
+        result[limit] = (unsigned int *) 1; // Canary
+        switch (kind * 2 + variant) {
+            case 2: name = "pixelsearchall1", c = pixelsearchall1(result, limit, start, end, q->color); break;
+            case 3: name = "pixelsearchall1x", c = pixelsearchall1x(result, limit, start, end, q->color); break;
+            case 4: name = "pixelsearchall2", c = pixelsearchall2(result, limit, start, end, rh, rl, gh, gl, bh, bl); break;
+            case 5: name = "pixelsearchall2x", c = pixelsearchall2x(result, limit, start, end, rh, rl, gh, gl, bh, bl); break;
+            case 6: name = "pixelsearchall3", c = pixelsearchall3(result, limit, start, end, (unsigned int *) q->colors, q->length); break;
+            case 7: name = "pixelsearchall3x", c = pixelsearchall3x(result, limit, start, end, (unsigned int *) q->colors, q->length); break;
+            case 8: name = "pixelsearchall4", c = pixelsearchall4(result, limit, start, end, (unsigned int *) q->highs, (unsigned int *) q->lows, q->length); break;
+            case 9: name = "pixelsearchall4x", c = pixelsearchall4x(result, limit, start, end, (unsigned int *) q->highs, (unsigned int *) q->lows, q->length); break;
+        }
+        if (c != count) {
+            fail(name, "returned a different count");
+            continue;
+        }
+        if (result[limit] != (unsigned int *) 1)
+            fail(name, "wrote past the limit");
+        unsigned char seen[MAX_PIXELS] = {0};
+        for (unsigned int i = 0; i < count; i++)
+            seen[all[i]] = 1;
+        for (unsigned int i = 0; i < limit && i < count; i++) {
+            size_t at = result[i] - start;
+            if (result[i] < start || result[i] >= end || !seen[at])
+                fail(name, "reported a pixel that does not match");
+            else if (seen[at]++ == 2)
+                fail(name, "reported the same pixel twice");
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------- Image search
+
+struct image {
+    unsigned int * start, width, height, stride; // Stride in bytes
+};
+
+// Returns 1 if the needle matches at (left, top). Transparent needle pixels match anything.
+static int fits(const struct image * hay, const struct image * needle, unsigned int left, unsigned int top, unsigned int variation, int exact) {
+    for (unsigned int i = 0; i < needle->height; i++)
+        for (unsigned int j = 0; j < needle->width; j++) {
+            unsigned int c = needle->start[i * needle->stride / 4 + j];
+            unsigned int p = hay->start[(top + i) * hay->stride / 4 + left + j];
+            if (!(c >> 24))
+                continue;
+            if (exact && c != p)
+                return 0;
+            if (!exact)
+                for (int k = 0; k < 24; k += 8) {
+                    int d = (int) (c >> k & 0xFF) - (int) (p >> k & 0xFF);
+                    if (d > (int) variation || d < -(int) variation)
+                        return 0;
+                }
+        }
+    return 1;
+}
+
+static void imagesearch_case(const struct image * hay, const struct image * needle, unsigned int x, unsigned int y, unsigned int variation) {
+    unsigned int * all[2][MAX_PIXELS];
+    unsigned int count[2] = {0, 0};
+    for (int exact = 1; exact >= 0; exact--)
+        if (needle->width <= hay->width && needle->height <= hay->height)
+            for (unsigned int top = 0; top + needle->height <= hay->height; top++)
+                for (unsigned int left = 0; left + needle->width <= hay->width; left++)
+                    if (fits(hay, needle, left, top, variation, exact))
+                        all[exact][count[exact]++] = hay->start + top * hay->stride / 4 + left;
+
+    unsigned int * first1 = count[1] ? all[1][0] : 0, * first2 = count[0] ? all[0][0] : 0;
+    tested += 2;
+    if (imagesearch1(hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y, 0) != first1)
+        fail("imagesearch1", "returned a different first match");
+    if (imagesearch2(hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y, variation, 0) != first2)
+        fail("imagesearch2", "returned a different first match");
+
+    for (int exact = 1; exact >= 0; exact--, tested++) {
+        unsigned int * result[LIMIT + 1], limit = next() % (count[exact] + 3);
+        if (limit > LIMIT)
+            limit = LIMIT;
+        result[limit] = (unsigned int *) 1;
+        const char * name = exact ? "imagesearchall1" : "imagesearchall2";
+        unsigned int c = exact
+            ? imagesearchall1(result, limit, hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y)
+            : imagesearchall2(result, limit, hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y, variation);
+        if (c != count[exact])
+            fail(name, "returned a different count");
+        else if (result[limit] != (unsigned int *) 1)
+            fail(name, "wrote past the limit");
+        else
+            for (unsigned int i = 0; i < limit && i < c; i++)
+                if (result[i] != all[exact][i])
+                    fail(name, "reported a different match");
+    }
+
+    // The rolling hash is only used for needles without transparent pixels, after many comparisons.
+    unsigned int columns[32], * result[LIMIT + 1], limit = next() % (count[1] + 3);
+    if (limit > LIMIT)
+        limit = LIMIT;
+    result[limit] = (unsigned int *) 1;
+    tested += 2;
+    if (imagesearch4(hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y, columns, 0) != first1)
+        fail("imagesearch4", "returned a different first match");
+    unsigned int c = imagesearchall4(result, limit, hay->start, hay->width, hay->height, hay->stride, needle->start, needle->width, needle->height, needle->stride, x, y, columns);
+    if (c != count[1])
+        fail("imagesearchall4", "returned a different count");
+    else if (result[limit] != (unsigned int *) 1)
+        fail("imagesearchall4", "wrote past the limit");
+    else
+        for (unsigned int i = 0; i < limit && i < c; i++)
+            if (result[i] != all[1][i])
+                fail("imagesearchall4", "reported a different match");
+}
+
+int main(int argc, char ** argv) {
+    unsigned long long cases = (argc > 1) ? strtoull(argv[1], 0, 10) : 200000;
+    seed = (argc > 2) ? (unsigned int) strtoul(argv[2], 0, 10) : 1;
+    page = sysconf(_SC_PAGESIZE);
+    region = mmap(0, page * 9, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+
+    for (current_case = 0; current_case < cases; current_case++) {
+        case_seed = seed;
+
+        // A palette of up to 4 colors with random alpha, blue, green, and red that may differ by a little.
+        unsigned int palette[4], colors = 1 + next() % 4;
+        unsigned int base = next();
+        for (unsigned int i = 0; i < colors; i++)
+            palette[i] = (next() % 3) ? base ^ (next() & 0x03030303) : next();
+
+        if (current_case % 4 != 3) {
+            // Pixel searches. Sizes are mostly small so every tail length is covered.
+            size_t n = (next() % 4) ? next() % 40 : next() % MAX_PIXELS;
+            unsigned int * start = guarded(n, current_case & 1), * end = start + n;
+            for (size_t i = 0; i < n; i++)
+                start[i] = palette[next() % colors];
+
+            struct query q;
+            unsigned int v = (next() % 2) ? next() % 8 : next() % 256;
+            q.color = palette[next() % colors] ^ ((next() % 8 == 0) ? 1 : 0);
+            q.high = q.low = 0;
+            for (int k = 0; k < 24; k += 8) {
+                unsigned int c = q.color >> k & 0xFF;
+                q.high |= (c + v > 255 ? 255 : c + v) << k;
+                q.low |= (c < v ? 0 : c - v) << k;
+            }
+            q.length = next() % 8;
+            for (unsigned int i = 0; i < q.length; i++) {
+                q.colors[i] = palette[next() % colors] ^ ((next() % 4 == 0) ? 0x10 : 0);
+                unsigned int w = next() % 16;
+                q.highs[i] = 0xFF000000, q.lows[i] = 0; // Alpha is not compared, as in ImagePut.PixelSearch
+                for (int k = 0; k < 24; k += 8) {
+                    unsigned int c = q.colors[i] >> k & 0xFF;
+                    q.highs[i] |= (c + w > 255 ? 255 : c + w) << k;
+                    q.lows[i] |= (c < w ? 0 : c - w) << k;
+                }
+            }
+            for (int kind = 1; kind <= 4; kind++)
+                pixelsearch_case(start, end, &q, kind, avx2);
+        }
+        else {
+            // Image searches over padded strides, with the needle planted zero to two times.
+            struct image hay, needle;
+            hay.width = 1 + next() % 24, hay.height = 1 + next() % 16;
+            hay.stride = 4 * (hay.width + next() % 4);
+            unsigned int * pixels = guarded(hay.stride / 4 * hay.height, current_case & 4);
+            hay.start = pixels;
+            for (unsigned int i = 0; i < hay.stride / 4 * hay.height; i++)
+                pixels[i] = palette[next() % colors];
+
+            static unsigned int needle_pixels[16 * 20];
+            needle.width = 1 + next() % 6, needle.height = 1 + next() % 6;
+            needle.stride = 4 * (needle.width + next() % 4);
+            needle.start = needle_pixels;
+            for (unsigned int i = 0; i < needle.stride / 4 * needle.height; i++) {
+                needle_pixels[i] = palette[next() % colors];
+                if (current_case & 8 && next() % 6 == 0)
+                    needle_pixels[i] &= 0x00FFFFFF; // Transparent in half of the cases
+            }
+            for (unsigned int k = next() % 3; k > 0 && needle.width <= hay.width && needle.height <= hay.height; k--) {
+                unsigned int left = next() % (hay.width - needle.width + 1), top = next() % (hay.height - needle.height + 1);
+                for (unsigned int i = 0; i < needle.height; i++)
+                    for (unsigned int j = 0; j < needle.width; j++)
+                        hay.start[(top + i) * hay.stride / 4 + left + j] = needle.start[i * needle.stride / 4 + j] | 0xFF000000;
+            }
+            unsigned int x = next() % needle.width, y = next() % needle.height;
+            imagesearch_case(&hay, &needle, x, y, (next() % 2) ? next() % 4 : next() % 64);
+        }
+    }
+
+    munmap(region, page * 9);
+    for (int i = 0; i < 64 && tally[i].kernel; i++)
+        printf("%8u %s %s\n", tally[i].count, tally[i].kernel, tally[i].what);
+    printf("%s differential: %llu cases, %u comparisons, %u failures\n", failures ? "FAIL" : "PASS", cases, tested, failures);
+    return failures != 0;
+}
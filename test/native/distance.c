@@ -0,0 +1,145 @@
+// The color distance searches in source/pixelsearch5x.c, pixelsearchall5x.c, and imagesearch5.c.
+// Build and run on Linux: gcc -O2 test/native/distance.c -lm -o distance && ./distance
+// Each metric is checked against a double precision reference. Colors whose distance lies within rounding of
+// the limit may fall either way. The searches must then agree with a plain loop over the same comparison.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/pixelsearch5x.c"
+#include "../../source/pixelsearchall5x.c"
+#include "../../source/imagesearch5.c"
+#include "test.h"
+
+static void lab(unsigned int c, double * l) {
+    double v[3], xyz[3];
+    for (int k = 0; k < 3; k++) {
+        double s = (c >> (16 - 8 * k) & 0xFF) / 255.0;
+        v[k] = s <= 0.04045 ? s / 12.92 : pow((s + 0.055) / 1.055, 2.4);
+    }
+    xyz[0] = (0.4124564 * v[0] + 0.3575761 * v[1] + 0.1804375 * v[2]) / 0.95047;
+    xyz[1] = 0.2126729 * v[0] + 0.7151522 * v[1] + 0.0721750 * v[2];
+    xyz[2] = (0.0193339 * v[0] + 0.1191920 * v[1] + 0.9503041 * v[2]) / 1.08883;
+    for (int k = 0; k < 3; k++)
+        xyz[k] = xyz[k] > 216.0 / 24389 ? cbrt(xyz[k]) : (24389.0 / 27 * xyz[k] + 16) / 116;
+    l[0] = 116 * xyz[1] - 16, l[1] = 500 * (xyz[0] - xyz[1]), l[2] = 200 * (xyz[1] - xyz[2]);
+}
+
+static double reference(unsigned int metric, unsigned int a, unsigned int b) {
+    double r1 = a >> 16 & 0xFF, g1 = a >> 8 & 0xFF, b1 = a & 0xFF, r2 = b >> 16 & 0xFF, g2 = b >> 8 & 0xFF, b2 = b & 0xFF;
+    if (metric == DISTANCE_RGB)
+        return sqrt((r1 - r2) * (r1 - r2) + (g1 - g2) * (g1 - g2) + (b1 - b2) * (b1 - b2));
+    if (metric == DISTANCE_REDMEAN) {
+        double mean = (r1 + r2) / 2;
+        return sqrt((2 + mean / 256) * (r1 - r2) * (r1 - r2) + 4 * (g1 - g2) * (g1 - g2) + (2 + (255 - mean) / 256) * (b1 - b2) * (b1 - b2));
+    }
+    double x[3], y[3];
+    lab(a, x), lab(b, y);
+    return sqrt((x[0] - y[0]) * (x[0] - y[0]) + (x[1] - y[1]) * (x[1] - y[1]) + (x[2] - y[2]) * (x[2] - y[2]));
+}
+
+// One pixel at a time, as the searches compare their last pixels.
+static int close_to(unsigned int metric, float distance, unsigned int a, unsigned int b) {
+    return near(metric, distance * distance, to_space(metric, _mm_cvtsi32_si128(a)), to_space(metric, _mm_cvtsi32_si128(b))) & 1;
+}
+
+int main(void) {
+    static const char * names[] = {"rgb", "redmean", "lab"};
+    static const float typical[] = {40, 60, 10};
+    static unsigned int hay[96 * 64], needle[16 * 16], * results[64], * expect[64];
+    int failures = 0;
+
+    // Known CIE L*a*b* values of sRGB white, red, and a mid gray.
+    struct space s = to_space(DISTANCE_LAB, _mm_setr_epi32(0xFFFFFFFF, 0xFFFF0000, 0xFF777777, 0));
+    float l[4], a[4], b[4];
+    _mm_storeu_ps(l, s.x), _mm_storeu_ps(a, s.y), _mm_storeu_ps(b, s.z);
+    failures += fabsf(l[0] - 100) > 0.01f || fabsf(a[0]) > 0.01f || fabsf(b[0]) > 0.01f;
+    failures += fabsf(l[1] - 53.24f) > 0.01f || fabsf(a[1] - 80.09f) > 0.01f || fabsf(b[1] - 67.20f) > 0.01f;
+    failures += fabsf(l[2] - 50.03f) > 0.01f || fabsf(a[2]) > 0.01f || fabsf(b[2]) > 0.01f;
+
+    // Pairs of colors, most of them near each other.
+    for (int t = 0; t < 300000; t++) {
+        unsigned int metric = t % 3, c1 = next() & 0xFFFFFF, c2 = c1;
+        for (int k = 0; k < 24; k += 8) {
+            int v = (c1 >> k & 0xFF) + (int) (next() % 61) - 30;
+            c2 = (c2 & ~(0xFFu << k)) | (unsigned int) (v < 0 ? 0 : v > 255 ? 255 : v) << k;
+        }
+        if (t % 7 == 0)
+            c2 = next() & 0xFFFFFF;
+        float distance = typical[metric] * (next() % 1000) / 500.0f;
+        double d = reference(metric, c1, c2), slack = metric == DISTANCE_LAB ? 0.005 : 0.0005;
+        int got = close_to(metric, distance, c1, c2);
+        if (fabs(d - distance) > slack && got != (d <= distance))
+            if (failures++ < 5)
+                printf("%s: %06X to %06X is %f, limit %f, got %d\n", names[metric], c1, c2, d, distance, got);
+    }
+
+    for (int t = 0; t < 20000; t++) {
+        unsigned int metric = t % 3, k = 1 + next() % 6;
+        unsigned int width = 1 + next() % 96, height = 1 + next() % 64, stride = width + next() % 4;
+        unsigned int w = 1 + next() % 16, h = 1 + next() % 16, pitch = w + next() % 3;
+        unsigned int x = next() % w, y = next() % h;
+        float distance = typical[metric] * (next() % 100) / 50.0f;
+
+        // A few base colors with noise, so pixels fall on both sides of the limit.
+        unsigned int base[6];
+        for (unsigned int i = 0; i < k; i++)
+            base[i] = next();
+        for (unsigned int i = 0; i < stride * height; i++)
+            hay[i] = base[next() % k] ^ (next() & 0x0F0F0F);
+        for (unsigned int i = 0; i < pitch * h; i++)
+            needle[i] = (base[next() % k] ^ (next() & 0x0F0F0F)) & (next() % 8 ? 0xFFFFFFFF : 0x00FFFFFF);
+
+        // pixelsearch5x and pixelsearchall5x against a plain loop.
+        unsigned int color = base[0], n = stride * height, count = 0, limit = next() % 64;
+        unsigned int * first = hay + n;
+        for (unsigned int i = 0; i < n; i++)
+            if (close_to(metric, distance, hay[i], color)) {
+                if (first == hay + n)
+                    first = hay + i;
+                if (count < limit)
+                    expect[count] = hay + i;
+                count++;
+            }
+        if (pixelsearch5x(hay, hay + n, color, metric, distance) != first)
+            if (failures++ < 5)
+                printf("pixelsearch5x %s case %d\n", names[metric], t);
+        if (pixelsearchall5x(results, limit, hay, hay + n, color, metric, distance) != count
+        || memcmp(results, expect, sizeof(*results) * (count < limit ? count : limit)))
+            if (failures++ < 5)
+                printf("pixelsearchall5x %s case %d\n", names[metric], t);
+
+        // imagesearch5 against every position in order.
+        struct imagesearch_stats want = {0}, stats = {0};
+        unsigned int * found = 0;
+        int blind = (needle[x + y * pitch] >> 24) == 0;
+        for (unsigned int top = 0; !found && top + h <= height; top++)
+            for (unsigned int left = 0; !found && left + w <= width; left++) {
+                unsigned int * at = hay + top * stride + left;
+                want.positions++;
+                if (!blind && !close_to(metric, distance, needle[x + y * pitch], at[x + y * stride]))
+                    continue;
+                want.anchors++, want.verifications++;
+                unsigned int row = h;
+                for (unsigned int i = 0; row == h && i < h; i++)
+                    for (unsigned int j = 0; j < w; j++)
+                        if (needle[i * pitch + j] >> 24 && !close_to(metric, distance, needle[i * pitch + j], at[i * stride + j])) {
+                            row = i;
+                            break;
+                        }
+                if (row == h)
+                    found = at, want.results++;
+                else
+                    want.rejections[row < 15 ? row : 15]++;
+            }
+        if (imagesearch5(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, metric, distance, &stats) != found
+        || memcmp(&stats, &want, sizeof(stats)))
+            if (failures++ < 5)
+                printf("imagesearch5 %s case %d: anchors %u/%u positions %u/%u\n", names[metric], t,
+                    stats.anchors, want.anchors, stats.positions, want.positions);
+    }
+
+    printf("%s distance: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,86 @@
+// The comparison in source/bitmapequal.c and the hash in source/pixelhash.c.
+// Build and run on Linux: gcc -O2 test/native/equal.c -o equal && ./equal
+// Both must ignore the padding at the end of each row. bitmapequal must find the first pixel that differs, and
+// pixelhash must give the same pixels the same hash at any stride and tell apart images that differ in one bit.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/bitmapequal.c"
+#include "../../source/pixelhash.c"
+#include "test.h"
+
+static int compare(const void * a, const void * b) {
+    unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    static unsigned int a[80 * 64], b[80 * 64];
+    static unsigned long long hashes[100000];
+    int failures = 0;
+
+    for (int t = 0; t < 50000; t++) {
+        unsigned int width = 1 + next() % 72, height = 1 + next() % 64;
+        unsigned int stride1 = width + (t % 3 ? next() % 8 : 0), stride2 = width + (t % 4 ? next() % 8 : 0);
+
+        // The same pixels in both, with different padding, and up to two differences.
+        for (unsigned int i = 0; i < stride1 * height; i++)
+            a[i] = next() % 4 ? 0xFF000000 : next();
+        for (unsigned int i = 0; i < stride2 * height; i++)
+            b[i] = next();
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++)
+                b[y * stride2 + x] = a[y * stride1 + x];
+        unsigned int n = width * height, first = n;
+        for (unsigned int k = next() % 3; k; k--) {
+            unsigned int i = next() % n;
+            b[i / width * stride2 + i % width] = a[i / width * stride1 + i % width] ^ 1u << (next() % 32);
+            first = (i < first) ? i : first;
+        }
+
+        unsigned int got = bitmapequal(a, b, width, height, 4 * stride1, 4 * stride2);
+        if (got != first)
+            if (failures++ < 5)
+                printf("bitmapequal case %d: %ux%u, strides %u and %u, got %u, expected %u\n", t, width, height, stride1, stride2, got, first);
+
+        unsigned long long h1 = pixelhash(a, width, height, 4 * stride1), h2 = pixelhash(b, width, height, 4 * stride2);
+        if ((h1 == h2) != (first == n))
+            if (failures++ < 5)
+                printf("pixelhash case %d: %ux%u, strides %u and %u, %s\n", t, width, height, stride1, stride2, first == n ? "differ" : "collide");
+    }
+
+    // One bit flipped anywhere in a screenshot-like image changes the hash, as does changing its shape.
+    unsigned int width = 80, height = 64;
+    for (unsigned int i = 0; i < width * height; i++)
+        a[i] = 0xFFF0F0F0;
+    unsigned long long base = pixelhash(a, width, height, 4 * width);
+    for (unsigned int i = 0; i < width * height; i += 7) {
+        for (unsigned int bit = 0; bit < 32; bit += 5) {
+            a[i] ^= 1u << bit;
+            failures += pixelhash(a, width, height, 4 * width) == base;
+            a[i] ^= 1u << bit;
+        }
+    }
+    failures += pixelhash(a, 40, 128, 160) == base || pixelhash(a, 160, 32, 640) == base;
+    failures += pixelhash(a, width, height, 4 * width) != base;
+
+    // No collisions among many small images that differ in a few pixels.
+    for (unsigned int t = 0; t < 100000; t++) {
+        unsigned int k = t;
+        for (unsigned int i = 0; i < 64; i++, k /= 3)
+            b[i] = 0xFF000000 | (k % 3) * 0x404040;
+        b[0] = t;
+        hashes[t] = pixelhash(b, 8, 8, 32);
+    }
+    unsigned long long seen = 0;
+    for (unsigned int t = 0; t < 100000; t++)
+        seen |= 1ull << (hashes[t] >> 58);
+    failures += seen != ~0ull; // The top bits are spread.
+    qsort(hashes, 100000, sizeof(*hashes), compare);
+    for (unsigned int t = 1; t < 100000; t++)
+        failures += hashes[t] == hashes[t - 1];
+
+    printf("%s equal: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,62 @@
+// Round trips and invalid input for source/hex.c at every SIMD level the CPU supports.
+// Build and run on Linux: gcc -O2 test/native/hex.c -o hex && ./hex
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../source/hex.c"
+
+#define MAX 300
+
+int main(void) {
+    static unsigned char bin[MAX], out[MAX];
+    static unsigned short expect[2 * MAX + 1], str[2 * MAX + 1];
+    int simd = level(), failures = 0;
+    srand(1);
+
+    for (int upper = 0; upper <= 1; upper++)
+        for (size_t size = 0; size <= MAX; size++) {
+            for (size_t i = 0; i < size; i++)
+                bin[i] = rand();
+            for (size_t i = 0; i < size; i++) {
+                expect[2 * i] = digits[upper][bin[i] >> 4];
+                expect[2 * i + 1] = digits[upper][bin[i] & 15];
+            }
+            size_t length = 2 * size;
+
+            // The public entry point, then each SIMD level on its own.
+            failures += hex(0, bin, size, str, upper) != (ptrdiff_t) length || memcmp(str, expect, 2 * length) || str[length];
+            if (simd >= 1) {
+                size_t n = encode_blocks_ssse3(bin, size, str, upper);
+                failures += n % 16 || memcmp(str, expect, 4 * n);
+                n = decode_blocks_ssse3(expect, length, out);
+                failures += n % 32 || memcmp(out, bin, n / 2);
+            }
+            if (simd >= 2) {
+                size_t n = encode_blocks_avx2(bin, size, str, upper);
+                failures += n % 32 || memcmp(str, expect, 4 * n);
+                n = decode_blocks_avx2(expect, length, out);
+                failures += n % 64 || memcmp(out, bin, n / 2);
+            }
+
+            // Either case decodes.
+            failures += hex(1, expect, length, out, 0) != (ptrdiff_t) size || memcmp(out, bin, size);
+
+            // Any other character is rejected wherever it appears.
+            static const unsigned short bad[] = {' ', '\n', '/', ':', '@', 'G', '`', 'g', 'x', 0x80, 0xFF, 0x130, 0};
+            for (size_t i = 0; i < length; i += 5) {
+                unsigned short c = expect[i];
+                for (size_t k = 0; k < sizeof(bad) / sizeof(*bad); k++) {
+                    expect[i] = bad[k];
+                    failures += hex(1, expect, length, out, 0) != -1;
+                }
+                expect[i] = c;
+            }
+
+            // Odd lengths are rejected.
+            if (length)
+                failures += hex(1, expect, length - 1, out, 0) != -1;
+        }
+
+    printf("%s hex at SIMD level %d: %d failures\n", failures ? "FAIL" : "PASS", simd, failures);
+    return failures != 0;
+}
@@ -0,0 +1,84 @@
+// The summed-area tables in source/integral.c.
+// Build and run on Linux: gcc -O2 test/native/integral.c -o integral && ./integral
+// Tables built in bands of rows, then carried down in bands of columns, as threads would build them, must give
+// the same mean and variance as summing each rectangle by hand. Rectangles are clipped to the image, and
+// variances are zero without squares.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../source/integral.c"
+#include "test.h"
+
+// Runs pass 1 over equal bands of rows, as ImagePut.Parallel splits them.
+static void rows(struct integral * r, unsigned int bands) {
+    r->bands = bands;
+    for (unsigned int i = 0; i < bands; i++) {
+        r->pass = 1, r->first = i * r->height / bands, r->last = (i + 1) * r->height / bands;
+        integral(r);
+    }
+}
+
+int main(void) {
+    static unsigned int pixels[70 * 60];
+    static unsigned long long sums[4 * 71 * 61] __attribute__((aligned(16))), squares[4 * 71 * 61] __attribute__((aligned(16)));
+    static int rects[4 * 100];
+    static double results[8 * 100];
+    int failures = 0;
+
+    for (int t = 0; t < 400; t++) {
+        unsigned int width = 1 + next() % 64, height = 1 + next() % 60, stride = width + next() % 6;
+        for (unsigned int i = 0; i < stride * height; i++)
+            pixels[i] = (t % 4 == 0) ? 0xFFFFFFFF : (t % 4 == 1) ? next() & 0xFF0F0F0F : next();
+
+        // Leftovers from the last image must not leak into the tables.
+        memset(sums, 0xA5, sizeof(sums));
+        memset(squares, 0x5A, sizeof(squares));
+        struct integral r = {.pixels = pixels, .sums = sums, .squares = (t % 5) ? squares : 0, .rects = rects,
+                             .results = results, .width = width, .height = height, .stride = 4 * stride};
+        rows(&r, 1 + next() % (height < 6 ? height : 6));
+        r.pass = 2;
+        BANDS(integral, &r, width + 1);
+
+        // Rectangles inside the image, and some hanging over its edges or empty.
+        for (unsigned int i = 0; i < 100; i++) {
+            int * rect = rects + 4 * i;
+            rect[0] = (int) (next() % (width + 4)) - 2, rect[1] = (int) (next() % (height + 4)) - 2;
+            rect[2] = next() % (width + 3), rect[3] = next() % (height + 3);
+            if (i == 0)
+                rect[0] = rect[1] = 0, rect[2] = width, rect[3] = height;
+        }
+        r.pass = 3;
+        BANDS(integral, &r, 100);
+
+        for (unsigned int i = 0; i < 100; i++) {
+            int * rect = rects + 4 * i;
+            double sum[4] = {0}, square[4] = {0}, n = 0, expect[8] = {0};
+            for (int y = rect[1]; y < rect[1] + rect[3]; y++)
+                for (int x = rect[0]; x < rect[0] + rect[2]; x++) {
+                    if (x < 0 || y < 0 || x >= (int) width || y >= (int) height)
+                        continue;
+                    unsigned int c = pixels[y * stride + x];
+                    for (int k = 0; k < 4; k++) {
+                        unsigned int v = c >> (8 * k) & 0xFF;
+                        sum[k] += v, square[k] += v * v;
+                    }
+                    n++;
+                }
+            for (int k = 0; k < 4 && n; k++) {
+                expect[k] = sum[k] / n;
+                expect[k + 4] = r.squares ? square[k] / n - expect[k] * expect[k] : 0;
+            }
+
+            for (int k = 0; k < 8; k++)
+                if (fabs(results[8 * i + k] - expect[k]) > 1e-6)
+                    if (failures++ < 5)
+                        printf("integral case %d: %ux%u, rectangle %d %d %d %d, value %d is %f, expected %f\n", t, width, height,
+                            rect[0], rect[1], rect[2], rect[3], k, results[8 * i + k], expect[k]);
+        }
+    }
+
+    printf("%s integral: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
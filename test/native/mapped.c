@@ -0,0 +1,109 @@
+// Writes a raw pixel file the way ImagePut.BitmapToARGB and BitmapAppend do, maps each frame the way
+// ImagePut.ARGBToBuffer does, and runs source/pixelsearch1.c directly over the mapping.
+// Build and run on Linux: gcc -O2 test/native/mapped.c -o mapped && ./mapped
+// mmap stands in for CreateFileMapping and MapViewOfFile. Both need the view to start on the
+// allocation granularity, which is 64 KB on Windows, so frames are mapped from the start of their granule.
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "../../source/pixelsearch1.c"
+
+#define GRANULARITY 0x10000
+
+struct header {
+    unsigned int magic, size, width, height, stride, format, frames, reserved, zero[8];
+};
+
+static unsigned int marker(unsigned int frame) {
+    return 0xFF000000 | (frame * 0x9E3779B9u & 0xFFFFFF) | 1;
+}
+
+// Each frame is a gray background with one marker pixel at a different place.
+static void draw(unsigned int * row, unsigned int width, unsigned int height, unsigned int stride, unsigned int frame) {
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < stride / 4; x++)
+            row[y * (stride / 4) + x] = (x < width) ? 0xFF808080 : 0;
+    row[(frame * 37 % height) * (stride / 4) + frame * 101 % width] = marker(frame);
+}
+
+// Appends a frame, creating the file on the first call. Returns the number of frames.
+static unsigned int append(int fd, unsigned int width, unsigned int height, const void * pixels) {
+    struct header h = {0x42475241, 64, width, height, (4 * width + 63) & ~63u, 0x26200A, 0, 0, {0}};
+    if (pread(fd, &h, sizeof h, 0) == 0 && pwrite(fd, &h, sizeof h, 0) != sizeof h)
+        return 0;
+    size_t size = (size_t) h.stride * h.height;
+    if (pwrite(fd, pixels, size, 64 + h.frames * size) != (ssize_t) size)
+        return 0;
+    h.frames++;
+    if (pwrite(fd, &h.frames, 4, 24) != 4)
+        return 0;
+    return h.frames;
+}
+
+int main(void) {
+    static const unsigned int sizes[][2] = {{1, 1}, {5, 3}, {17, 40}, {640, 480}, {1920, 1080}};
+    int failures = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        unsigned int width = sizes[s][0], height = sizes[s][1], stride = (4 * width + 63) & ~63u, frames = 7;
+        size_t size = (size_t) stride * height;
+        unsigned int * pixels = malloc(size);
+        char path[] = "/tmp/mappedXXXXXX";
+        int fd = mkstemp(path);
+        unlink(path);
+        if (fd < 0)
+            return 1;
+
+        for (unsigned int k = 0; k < frames; k++) {
+            draw(pixels, width, height, stride, k);
+            failures += append(fd, width, height, pixels) != k + 1;
+        }
+
+        // Check the header and the length of the file.
+        struct header h;
+        failures += pread(fd, &h, sizeof h, 0) != sizeof h;
+        failures += h.magic != 0x42475241 || h.size != 64 || h.width != width || h.height != height
+                 || h.stride != stride || h.format != 0x26200A || h.frames != frames;
+        failures += lseek(fd, 0, SEEK_END) != (off_t) (64 + frames * size);
+
+        // Map one frame at a time and search it in place. Nothing is read until the pages are touched.
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (unsigned int k = 0; k < frames; k++) {
+            off_t offset = 64 + k * size, base = offset & ~(off_t) (GRANULARITY - 1);
+            size_t length = offset - base + size;
+            unsigned char * view = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+            if (view == MAP_FAILED) {
+                failures++;
+                continue;
+            }
+            unsigned int * start = (unsigned int *) (view + (offset - base)), * end = start + size / 4;
+            failures += ((size_t) start & 63) != 0;
+
+            unsigned int * found = pixelsearch1(start, end, marker(k));
+            size_t i = found - start;
+            failures += found == end || i / (stride / 4) != k * 37 % height || i % (stride / 4) != k * 101 % width;
+
+            // Writes through the view reach the file.
+            *start = 0xFFFF0000;
+            msync(view, length, MS_SYNC);
+            munmap(view, length);
+            unsigned int back = 0;
+            failures += pread(fd, &back, 4, offset) != 4 || back != 0xFFFF0000;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (width >= 640)
+            printf("%ux%u: mapped and searched %u frames in %.1f ms\n", width, height, frames,
+                (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+        close(fd);
+        free(pixels);
+    }
+
+    printf("%s mapped: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,121 @@
+// Packing and unpacking channels in source/pack.c.
+// Build and run on Linux: gcc -O2 test/native/pack.c -o pack && ./pack
+// Every layout, type, and order of channels is checked against a plain reference, on rectangles with padding,
+// in random bands of rows. Unpacking must leave other channels and the padding alone, must clamp floats, and
+// must restore the pixels that were packed. Packing must only read the pixels, as from a raw pixel file mapped
+// read-only.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../../source/pack.c"
+#include "test.h"
+
+static void run(struct pack * r, unsigned int pass) {
+    r->pass = pass;
+    BANDS(pack, r, r->height);
+}
+
+int main(void) {
+    static unsigned int image[50 * 40], copy[50 * 40], expect[50 * 40];
+    static unsigned char bytes[4 * 50 * 40 + 4];
+    static float floats[4 * 50 * 40];
+    int failures = 0;
+
+    for (int t = 0; t < 20000; t++) {
+        unsigned int width = 1 + next() % 40, height = 1 + next() % 40, stride = width + next() % 10;
+        for (unsigned int i = 0; i < stride * height; i++)
+            image[i] = next();
+
+        // Distinct channels in any order.
+        struct pack r = {.pixels = image, .width = width, .height = height, .stride = 4 * stride, .channels = 1 + next() % 4};
+        unsigned char all[4] = {0, 1, 2, 3};
+        for (unsigned int c = 0; c < 4; c++) {
+            unsigned int k = c + next() % (4 - c), swap = all[c];
+            all[c] = all[k], all[k] = swap;
+        }
+        memcpy(r.order, all, 4);
+        r.planar = next() % 2;
+        r.floats = next() % 2;
+        r.data = r.floats ? (void *) floats : (void *) bytes;
+        for (unsigned int c = 0; c < 4; c++)
+            r.scale[c] = 1 / 255.0f / (1 + c), r.bias[c] = -0.25f * c;
+
+        size_t n = (size_t) width * height * r.channels, plane = (size_t) width * height;
+        #define INDEX(x, y, c) (r.planar ? (c) * plane + (size_t) (y) * width + (x) : ((size_t) (y) * width + (x)) * r.channels + (c))
+
+        // Pack. Nothing is written past the end of the array.
+        memset(bytes + n, 0xAB, 4);
+        run(&r, 0);
+        int wrong = r.floats ? 0 : memcmp(bytes + n, "\xAB\xAB\xAB\xAB", 4) != 0;
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++)
+                for (unsigned int c = 0; c < r.channels; c++) {
+                    unsigned int v = image[y * stride + x] >> (8 * r.order[c]) & 0xFF;
+                    size_t i = INDEX(x, y, c);
+                    wrong |= r.floats ? fabsf(floats[i] - (v * r.scale[c] + r.bias[c])) > 1e-6f : bytes[i] != v;
+                }
+
+        // Unpacking what was packed with the inverse transform restores the image.
+        memcpy(copy, image, sizeof(image));
+        for (unsigned int c = 0; c < 4; c++)
+            r.scale[c] = 255.0f * (1 + c), r.bias[c] = 255.0f * (1 + c) * 0.25f * c;
+        run(&r, 1);
+        wrong |= memcmp(copy, image, sizeof(image)) != 0;
+
+        // Unpacking new values changes only the packed channels of the rectangle.
+        for (size_t i = 0; i < n; i++) {
+            bytes[i] = next();
+            floats[i] = (float) ((int) (next() % 400) - 70) + (next() % 4) * 0.25f;
+        }
+        for (unsigned int c = 0; c < 4; c++)
+            r.scale[c] = 1, r.bias[c] = 0;
+        memcpy(expect, image, sizeof(image));
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++)
+                for (unsigned int c = 0; c < r.channels; c++) {
+                    size_t i = INDEX(x, y, c);
+                    float f = floats[i];
+                    int v = r.floats ? (int) nearbyintf(f) : bytes[i];
+                    v = v < 0 ? 0 : v > 255 ? 255 : v;
+                    unsigned int shift = 8 * r.order[c];
+                    expect[y * stride + x] = (expect[y * stride + x] & ~(0xFFu << shift)) | (unsigned int) v << shift;
+                }
+        run(&r, 1);
+        wrong |= memcmp(expect, image, sizeof(image)) != 0;
+
+        if (wrong && failures++ < 5)
+            printf("pack case %d: %ux%u, stride %u, %u channels, %s %s\n", t, width, height, stride, r.channels,
+                r.planar ? "planar" : "interleaved", r.floats ? "floats" : "bytes");
+    }
+
+    // Pack every layout from pixels that cannot be written. A write faults.
+    size_t page = 4 * 50 * 40;
+    unsigned int * readonly = mmap(0, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    for (unsigned int i = 0; i < 50 * 40; i++)
+        readonly[i] = next();
+    mprotect(readonly, page, PROT_READ);
+    for (unsigned int t = 0; t < 32; t++) {
+        struct pack r = {.pixels = readonly, .scale = {1, 1, 1, 1}, .width = 37, .height = 40, .stride = 4 * 50,
+                         .channels = 1 + t % 4, .order = {3, 2, 1, 0}, .planar = t / 4 % 2, .floats = t / 8 % 2};
+        r.data = r.floats ? (void *) floats : (void *) bytes;
+        run(&r, 0);
+        int wrong = 0;
+        for (unsigned int y = 0; y < r.height; y++)
+            for (unsigned int x = 0; x < r.width; x++)
+                for (unsigned int c = 0; c < r.channels; c++) {
+                    unsigned int v = readonly[y * 50 + x] >> (8 * r.order[c]) & 0xFF;
+                    size_t i = r.planar ? c * (size_t) r.width * r.height + y * r.width + x : (y * r.width + x) * r.channels + c;
+                    wrong |= r.floats ? floats[i] != v : bytes[i] != v;
+                }
+        if (wrong && failures++ < 5)
+            printf("pack read-only case %u: %u channels, %s %s\n", t, r.channels,
+                r.planar ? "planar" : "interleaved", r.floats ? "floats" : "bytes");
+    }
+    munmap(readonly, page);
+
+    printf("%s pack: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,118 @@
+// Palette indexing in source/palette.c and the searches over its planes, checked against the 32-bit kernels.
+// Build and run on Linux: gcc -O2 test/native/palette.c -o palette && ./palette
+// Every plane must map back to the pixels it came from, and a search of the plane must find the same pixel
+// or image as the search of the pixels, with the same counters.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/palette.c"
+#include "../../source/pixelsearch1.c"
+#include "../../source/pixelsearch1b.c"
+#include "../../source/imagesearch1.c"
+#include "../../source/imagesearch1b.c"
+#include "test.h"
+
+int main(void) {
+    static unsigned int hay[128 * 96], needle[24 * 24], colors[256], table[PALETTE_SLOTS], ncolors[256], ntable[PALETTE_SLOTS];
+    static unsigned char plane[128 * 96], nplane[24 * 24];
+    int failures = 0;
+
+    for (int t = 0; t < 20000; t++) {
+        unsigned int width = 1 + next() % 128, height = 1 + next() % 96, stride = width + next() % 4;
+        unsigned int w = 1 + next() % 24, h = 1 + next() % 24, pitch = w + next() % 3;
+        unsigned int x = next() % w, y = next() % h, k = 1 + next() % (t % 3 ? 8 : 255);
+
+        // Runs of one color, drawn from k colors. Half the palettes include zero, which palette.c must not
+        // mistake for the start of a row.
+        for (unsigned int i = 0; i < stride * height; i++)
+            hay[i] = i && next() % 3 ? hay[i - 1] : (t % 2 ? 0 : 0xFF000000) | (next() % k) * 0x010101;
+
+        // Cut the needle from the haystack, with some transparent pixels, or make one up.
+        unsigned int top = next() % height, left = next() % width;
+        for (unsigned int i = 0; i < h; i++)
+            for (unsigned int j = 0; j < w; j++)
+                needle[i * pitch + j] = (t % 5 == 0 || top + i >= height || left + j >= width)
+                    ? 0xFF000000 | (next() % k) * 0x010101
+                    : hay[(top + i) * stride + left + j] & (next() % 8 ? 0xFFFFFFFF : 0x00FFFFFF);
+
+        memset(table, 0, sizeof(table));
+        unsigned int count = palette(hay, width, height, 4 * stride, plane, colors, table, 0, 0);
+        if (count > 255) {
+            failures++;
+            continue;
+        }
+
+        // The plane maps back to the haystack.
+        for (unsigned int i = 0; i < width * height; i++)
+            if (plane[i] >= count || colors[plane[i]] != hay[i / width * stride + i % width]) {
+                if (failures++ < 5)
+                    printf("palette case %d: pixel %u\n", t, i);
+                break;
+            }
+
+        // Mapping onto a copy of the palette adds no colors and does not disturb it.
+        memcpy(ncolors, colors, sizeof(colors));
+        memcpy(ntable, table, sizeof(table));
+        unsigned int mapped = palette(needle, w, h, 4 * pitch, nplane, ncolors, ntable, count, 1);
+        int missing = 0;
+        for (unsigned int i = 0; i < h; i++)
+            for (unsigned int j = 0; j < w; j++) {
+                unsigned int c = needle[i * pitch + j];
+                int known = 0;
+                for (unsigned int n = 0; n < count; n++)
+                    known |= colors[n] == c;
+                missing |= (c >> 24) && !known;
+                if (mapped == count && ((c >> 24) ? colors[nplane[i * w + j]] != c : nplane[i * w + j] != 255))
+                    missing = 2;
+            }
+        if ((mapped == 256) != (missing == 1) || missing == 2 || memcmp(ntable, table, sizeof(table))) {
+            if (failures++ < 5)
+                printf("palette case %d: needle mapped to %u of %u colors\n", t, mapped, count);
+            continue;
+        }
+
+        // Every color in the palette is found where pixelsearch1 finds it, and none other is found.
+        if (stride == width) {
+            unsigned int target = next() % 2 ? colors[next() % count] : 0xFF123456;
+            unsigned int * p = pixelsearch1(hay, hay + width * height, target);
+            int slot = -1;
+            for (unsigned int n = 0; n < count; n++)
+                if (colors[n] == target)
+                    slot = n;
+            unsigned char * b = slot < 0 ? plane + width * height : pixelsearch1b(plane, plane + width * height, slot);
+            if (b - plane != p - hay)
+                if (failures++ < 5)
+                    printf("pixelsearch1b case %d: %ld, expected %ld\n", t, (long) (b - plane), (long) (p - hay));
+        }
+
+        // The image search finds the same position with the same counters, unless the needle has a color the
+        // haystack does not, in which case imagesearch1 must not find it either.
+        struct imagesearch_stats expect = {0}, stats = {0};
+        unsigned int * first = imagesearch1(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, &expect);
+        if (mapped == 256) {
+            if (first && failures++ < 5)
+                printf("imagesearch1b case %d: needle has a color the haystack lacks, but was found\n", t);
+            continue;
+        }
+        unsigned char * found = imagesearch1b(plane, width, height, nplane, w, h, x, y, &stats);
+        long at = found ? found - plane : -1, expected = first ? (first - hay) / stride * width + (first - hay) % stride : -1;
+        if (at != expected || memcmp(&stats, &expect, sizeof(stats)))
+            if (failures++ < 5)
+                printf("imagesearch1b case %d: %ld, expected %ld, anchors %u/%u verifications %u/%u positions %u/%u\n",
+                    t, at, expected, stats.anchors, expect.anchors, stats.verifications, expect.verifications,
+                    stats.positions, expect.positions);
+    }
+
+    // A 256th color does not fit.
+    static unsigned int many[256];
+    for (unsigned int i = 0; i < 256; i++)
+        many[i] = 0xFF000000 | i;
+    memset(table, 0, sizeof(table));
+    failures += palette(many, 255, 1, 1020, plane, colors, table, 0, 0) != 255;
+    memset(table, 0, sizeof(table));
+    failures += palette(many, 256, 1, 1024, plane, colors, table, 0, 0) != 256;
+
+    printf("%s palette: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
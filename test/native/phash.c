@@ -0,0 +1,107 @@
+// The perceptual hashes in source/phash.c and the index of source/hashindex.c.
+// Build and run on Linux: gcc -O2 test/native/phash.c -o phash && ./phash
+// Hashes must not depend on the stride, must stay close when an image is scaled or brightened, and must be far
+// apart for different images. Every query of the index must find exactly the hashes that a linear scan finds.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/phash.c"
+#include "../../source/hashindex.c"
+#include "test.h"
+
+// A screen of flat panels and blocks of text, scaled to width x height and brightened by light.
+static void draw(unsigned int * p, unsigned int width, unsigned int height, unsigned int stride, unsigned int layout, int light) {
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int u = x * 640 / width, v = y * 480 / height, c;
+            c = ((u / 160 + v / 120 * 3 + layout) % 4) * 60 + 20;
+            if (v % 120 > 30 && v % 120 < 90 && u % 160 > 20 && u % 160 < 20 + (layout * 37 + v / 120 * 53) % 120)
+                c = 235 - c;
+            c = c + light > 255 ? 255 : c + light;
+            p[y * stride + x] = 0xFF000000 | c * 0x010101;
+        }
+}
+
+int main(void) {
+    static unsigned int a[640 * 480 + 4096], b[640 * 480 + 4096];
+    static unsigned long long hashes[20000], query_hashes[200];
+    static unsigned int offsets[4 * (HASHINDEX_BUCKETS + 1)], positions[4 * 20000], results[2 * 20000];
+    static unsigned char expect[20000];
+    int failures = 0;
+
+    // Simple patterns.
+    for (unsigned int i = 0; i < 64 * 64; i++)
+        a[i] = (i % 64 < 32) ? 0xFF101010 : 0xFFF0F0F0;
+    failures += phash(a, 64, 64, 256, PHASH_AVERAGE) != 0xF0F0F0F0F0F0F0F0ull;
+    for (unsigned int i = 0; i < 90 * 8; i++)
+        a[i] = 0xFF000000 | (i % 90) * 0x020202;
+    failures += phash(a, 90, 8, 360, PHASH_DIFFERENCE) != ~0ull;
+
+    for (unsigned int kind = PHASH_AVERAGE; kind <= PHASH_DCT; kind++) {
+        for (unsigned int layout = 0; layout < 8; layout++) {
+            // The same pixels at another stride hash the same.
+            draw(a, 640, 480, 640, layout, 0);
+            draw(b, 640, 480, 643, layout, 0);
+            unsigned long long h = phash(a, 640, 480, 4 * 640, kind);
+            failures += phash(b, 640, 480, 4 * 643, kind) != h;
+
+            // Scaled and brightened versions stay close.
+            draw(b, 333, 250, 333, layout, 0);
+            unsigned int scaled = distance(h, phash(b, 333, 250, 4 * 333, kind));
+            draw(b, 640, 480, 640, layout, 12);
+            unsigned int brighter = distance(h, phash(b, 640, 480, 4 * 640, kind));
+
+            // Another screen is far away.
+            draw(b, 640, 480, 640, layout + 1, 0);
+            unsigned int other = distance(h, phash(b, 640, 480, 4 * 640, kind));
+
+            if (scaled > 6 || brighter > 6 || other < 12)
+                if (failures++ < 5)
+                    printf("phash kind %u layout %u: scaled %u, brighter %u, other %u bits away\n", kind, layout, scaled, brighter, other);
+        }
+    }
+
+    // Tiny images repeat their pixels.
+    a[0] = 0xFFFFFFFF;
+    failures += phash(a, 1, 1, 4, PHASH_AVERAGE) != 0 || phash(a, 1, 1, 4, PHASH_DIFFERENCE) != 0;
+
+    // Clusters of hashes a few bits apart, and some far from everything.
+    for (unsigned int i = 0; i < 20000; i++) {
+        unsigned long long h = (i % 10 == 0 || i < 50) ? (unsigned long long) next() << 32 | next() : hashes[next() % (i / 10 * 10 + 1)];
+        for (unsigned int k = next() % 8; k; k--)
+            h ^= 1ull << (next() % 64);
+        hashes[i] = h;
+    }
+    for (unsigned int q = 0; q < 200; q++)
+        query_hashes[q] = hashes[next() % 20000] ^ (q % 3 ? 1ull << (next() % 64) : 0);
+
+    static const unsigned int sizes[] = {1, 10, 100, 3000, 20000};
+    for (unsigned int z = 0; z < 5; z++) {
+        unsigned int n = sizes[z];
+        struct hashindex index = {hashes, offsets, positions, n};
+        hashindex(&index, 0, 0, 0, 0, 0);
+
+        for (unsigned int q = 0; q < 200; q++) {
+            unsigned int radius = (q % 5 == 0) ? next() % 65 : next() % 16, limit = n;
+            unsigned int want = 0;
+            for (unsigned int i = 0; i < n; i++)
+                want += expect[i] = distance(hashes[i], query_hashes[q]) <= radius;
+
+            unsigned int got = hashindex(&index, 1, query_hashes[q], radius, results, limit), wrong = got != want;
+            for (unsigned int i = 0; !wrong && i < got; i++) {
+                unsigned int position = results[2 * i];
+                wrong |= !expect[position] || results[2 * i + 1] != distance(hashes[position], query_hashes[q]);
+                expect[position] = 0; // Found twice is wrong too.
+            }
+            if (wrong && failures++ < 5)
+                printf("hashindex %u hashes, query %u, radius %u: found %u of %u\n", n, q, radius, got, want);
+
+            // A smaller limit keeps the count.
+            failures += hashindex(&index, 1, query_hashes[q], radius, results, got / 2) != got;
+        }
+    }
+
+    printf("%s phash: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
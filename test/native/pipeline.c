@@ -0,0 +1,150 @@
+// Synthetic frame source for source/pipeline.c.
+// Build and run on Linux: gcc -O2 -pthread test/native/pipeline.c -o pipeline && ./pipeline
+// Frame n is filled with gray and has a marker pixel and a 4x4 template placed at positions derived
+// from n, so the main thread can check the results posted by the workers against the frame number.
+// Every few messages are refused as if the queue were full, and their slots must still return to the ring.
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../source/pipeline.c"
+
+#define WIDTH   160
+#define HEIGHT  90
+#define FRAMES  2000
+#define WORKERS 3
+#define MARKER  0xFFFF0000
+#define GRAY    0xFF808080
+
+// Messages posted by the workers, read by the main thread as if it were a window procedure.
+static struct { unsigned int slot, sequence; } queue[1 << 16];
+static unsigned int posted, handled, refused;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int wait(void * handle, unsigned int milliseconds) {
+    sched_yield();
+    return 0;
+}
+
+static int post(void * hwnd, unsigned int msg, __UINTPTR_TYPE__ wparam, __INTPTR_TYPE__ lparam) {
+    pthread_mutex_lock(&lock);
+    if ((posted + refused) % 7 == 6) {
+        __atomic_store_n(&refused, refused + 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    queue[posted % (1 << 16)].slot = wparam;
+    queue[posted % (1 << 16)].sequence = lparam;
+    __atomic_store_n(&posted, posted + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&lock);
+    return 1;
+}
+
+static unsigned int needle[16];
+
+static void place(unsigned int n, int * mx, int * my, int * tx, int * ty) {
+    *mx = n * 7 % WIDTH;
+    *my = n * 3 % (HEIGHT / 2);         // Marker in the top half
+    *tx = n * 5 % (WIDTH - 4);
+    *ty = HEIGHT / 2 + n % (HEIGHT / 2 - 4); // Template in the bottom half
+}
+
+static void draw(unsigned int * frame, unsigned int n) {
+    int mx, my, tx, ty;
+    place(n, &mx, &my, &tx, &ty);
+    for (int i = 0; i < WIDTH * HEIGHT; i++)
+        frame[i] = GRAY;
+    frame[my * WIDTH + mx] = MARKER;
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            frame[(ty + y) * WIDTH + tx + x] = needle[y * 4 + x];
+}
+
+static unsigned int * worker(void * arg) {
+    pipeline(arg);
+    return 0;
+}
+
+int main(void) {
+    for (int i = 0; i < 16; i++)
+        needle[i] = 0xFF000000 | (i * 0x0F0B07);
+
+    struct ring r = {0};
+    r.capacity = 6;
+    r.width = WIDTH;
+    r.height = HEIGHT;
+    r.stride = 4 * WIDTH + 64;
+    r.size = r.stride * HEIGHT;
+    r.policy = 1; // Drop newest, so that every published frame is processed.
+    r.pixels = calloc(r.capacity, r.size);
+    r.state = calloc(r.capacity, 4);
+    r.sequence = calloc(r.capacity, 4);
+
+    struct search searches[3] = {
+        {.type = 1, .color = MARKER},
+        {.type = 2, .needle = needle, .w = 4, .h = 4, .pitch = 16, .x = 2, .y = 2},
+        {.type = 3, .color = GRAY},
+    };
+
+    struct pipeline p = {0};
+    p.ring = &r;
+    p.searches = searches;
+    p.count = 3;
+    p.results = calloc(r.capacity * p.count, sizeof(struct result));
+    p.wait = wait;
+    p.post = post;
+
+    pthread_t threads[WORKERS];
+    for (int i = 0; i < WORKERS; i++)
+        pthread_create(threads + i, 0, (void * (*)(void *)) worker, &p);
+
+    // The frame numbers of written frames, so that results can be checked after drops.
+    static unsigned int frame[WIDTH * HEIGHT];
+    static unsigned int drawn[FRAMES + 1];
+    unsigned int errors = 0, written = 0;
+
+    for (unsigned int n = 1; n <= FRAMES || handled + __atomic_load_n(&refused, __ATOMIC_ACQUIRE) < written; n++) {
+        if (n <= FRAMES) {
+            draw(frame, n);
+            int slot = ring(&r, 0, 0, 0, 0);
+            if (slot >= 0) {
+                ring(&r, 1, slot, (unsigned char *) frame, 4 * WIDTH);
+                drawn[++written] = n;
+            }
+        }
+
+        // Handle the posted messages.
+        while (handled < __atomic_load_n(&posted, __ATOMIC_ACQUIRE)) {
+            pthread_mutex_lock(&lock);
+            unsigned int slot = queue[handled % (1 << 16)].slot;
+            unsigned int sequence = queue[handled % (1 << 16)].sequence;
+            pthread_mutex_unlock(&lock);
+
+            int mx, my, tx, ty;
+            place(drawn[sequence], &mx, &my, &tx, &ty);
+            struct result * res = p.results + slot * p.count;
+            errors += !(res[0].count == 1 && res[0].x == mx && res[0].y == my);
+            errors += !(res[1].count == 1 && res[1].x == tx && res[1].y == ty);
+            errors += !(res[2].count == WIDTH * HEIGHT - 17);
+
+            ring(&r, 3, slot, 0, 0);
+            handled++;
+        }
+        sched_yield();
+    }
+
+    __atomic_store_n(&p.stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < WORKERS; i++)
+        pthread_join(threads[i], 0);
+
+    // Every slot is free again, including those of refused messages.
+    unsigned int leaked = 0;
+    for (unsigned int i = 0; i < r.capacity; i++)
+        leaked += (r.state[i] != FREE);
+
+    int ok = (errors == 0) && (leaked == 0) && (refused > 0) && (handled + refused == written) && (written + r.dropped == FRAMES);
+    printf("%s %u frames written, %u handled, %u refused, %u dropped, %u leaked, %u errors\n",
+        ok ? "PASS" : "FAIL", written, handled, refused, r.dropped, leaked, errors);
+    return !ok;
+}
@@ -0,0 +1,195 @@
+// Encodes synthetic images with source/png.c at every preset and band count, then decodes them with zlib.
+// Build and run on Linux: gcc -O2 -pthread test/native/png.c -o png -lz && ./png
+// The PNG is assembled the same way as ImagePut.PNGEncode: signature, IHDR, one IDAT per band,
+// an IDAT with the combined Adler-32, and IEND. Every chunk CRC is checked and the rows are unfiltered
+// and compared with the source pixels.
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../source/png.c"
+
+// zlib.h declares deflate, crc32, and adler32, which png.c already defines.
+int uncompress(unsigned char * dest, unsigned long * destLen, const unsigned char * source, unsigned long sourceLen);
+
+static unsigned int crc_table[8 * 256];
+
+static unsigned int combine(unsigned int a1, unsigned int a2, unsigned int len2) {
+    unsigned int rem = len2 % 65521, sum1 = a1 & 0xFFFF, sum2 = (unsigned long long) rem * sum1 % 65521;
+    sum1 += (a2 & 0xFFFF) + 65521 - 1;
+    sum2 += (a1 >> 16) + (a2 >> 16) + 65521 - rem;
+    sum1 = sum1 % 65521;
+    sum2 = sum2 % 65521;
+    return sum2 << 16 | sum1;
+}
+
+static void * worker(void * job) {
+    png(job);
+    return 0;
+}
+
+static unsigned char * append(unsigned char * p, const char * type, const unsigned char * data, unsigned int size) {
+    store32(p, size);
+    memcpy(p + 4, type, 4);
+    if (size)
+        memcpy(p + 8, data, size);
+    store32(p + 8 + size, crc32(crc_table, p + 4, size + 4));
+    return p + 12 + size;
+}
+
+// Returns the size of the PNG written to file.
+static unsigned int encode_png(unsigned char * pixels, unsigned int width, unsigned int height, unsigned int level, int bands, unsigned char * file, unsigned int * bpp) {
+    struct png setup = {.pixels = pixels, .crc = crc_table, .width = width, .height = height, .stride = 4 * width, .level = level};
+    png(&setup);
+    *bpp = setup.bpp;
+
+    unsigned int pitch = 1 + setup.bpp * width;
+    unsigned char * filtered = malloc((size_t) height * pitch);
+    struct png jobs[64];
+    pthread_t threads[64];
+    bands = (bands > (int) height) ? (int) height : bands;
+    for (int k = 0; k < bands; k++) {
+        unsigned int first = height * k / bands, last = height * (k + 1) / bands, raw = (last - first) * pitch;
+        jobs[k] = setup;
+        jobs[k].filtered = filtered;
+        jobs[k].out = malloc(raw + raw / 2048 + 64);
+        jobs[k].work = malloc(SCRATCH + 6 * (4 * width + 48));
+        jobs[k].pass = 1;
+        jobs[k].first = first;
+        jobs[k].last = last;
+        pthread_create(threads + k, 0, worker, jobs + k);
+    }
+
+    unsigned char * p = file, ihdr[13];
+    memcpy(p, "\x89PNG\r\n\x1A\n", 8);
+    store32(ihdr, width);
+    store32(ihdr + 4, height);
+    ihdr[8] = 8, ihdr[9] = (setup.bpp == 3) ? 2 : 6, ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    p = append(p + 8, "IHDR", ihdr, 13);
+
+    unsigned int adler = 1;
+    for (int k = 0; k < bands; k++) {
+        pthread_join(threads[k], 0);
+        memcpy(p, jobs[k].out, jobs[k].size);
+        p += jobs[k].size;
+        adler = combine(adler, jobs[k].adler, (jobs[k].last - jobs[k].first) * pitch);
+        free(jobs[k].out);
+        free(jobs[k].work);
+    }
+    unsigned char trailer[4];
+    store32(trailer, adler);
+    p = append(p, "IDAT", trailer, 4);
+    p = append(p, "IEND", 0, 0);
+    free(filtered);
+    return p - file;
+}
+
+// Returns the number of mismatches between the decoded PNG and the pixels.
+static int check(const unsigned char * file, unsigned int size, const unsigned char * pixels, unsigned int width, unsigned int height, unsigned int bpp) {
+    unsigned int pitch = 1 + bpp * width, idat = 0;
+    unsigned char * stream = malloc(size), * raw = malloc((size_t) height * pitch + 1);
+
+    if (memcmp(file, "\x89PNG\r\n\x1A\n", 8))
+        return 1;
+    for (unsigned int i = 8; i < size;) {
+        unsigned char crc[4];
+        unsigned int n = (unsigned int) file[i] << 24 | file[i + 1] << 16 | file[i + 2] << 8 | file[i + 3];
+        store32(crc, crc32(crc_table, file + i + 4, n + 4));
+        if (memcmp(crc, file + i + 8 + n, 4))
+            return 1;
+        if (!memcmp(file + i + 4, "IDAT", 4))
+            memcpy(stream + idat, file + i + 8, n), idat += n;
+        i += 12 + n;
+    }
+
+    unsigned long length = (unsigned long) height * pitch + 1;
+    if (uncompress(raw, &length, stream, idat) != 0 || length != (unsigned long) height * pitch)
+        return 1;
+
+    // Undo the filters in place and compare.
+    int failures = 0;
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned char * row = raw + y * pitch + 1, * up = (y > 0) ? row - pitch : 0;
+        for (unsigned int i = 0; i < pitch - 1; i++) {
+            int a = (i >= bpp) ? row[i - bpp] : 0, b = up ? up[i] : 0, c = (up && i >= bpp) ? up[i - bpp] : 0;
+            switch (row[-1]) {
+                case 0: break;
+                case 1: row[i] += a; break;
+                case 2: row[i] += b; break;
+                case 3: row[i] += (a + b) / 2; break;
+                case 4: row[i] += paeth(a, b, c); break;
+                default: return 1;
+            }
+        }
+        for (unsigned int x = 0; x < width; x++) {
+            const unsigned char * s = pixels + 4 * (y * width + x);
+            unsigned char * d = row + bpp * x;
+            failures += d[0] != s[2] || d[1] != s[1] || d[2] != s[0] || (bpp == 4 && d[3] != s[3]);
+        }
+    }
+    free(stream);
+    free(raw);
+    return failures != 0;
+}
+
+static void fill(unsigned int * p, unsigned int width, unsigned int height, int kind) {
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int v = 0;
+            if (kind == 0) v = 0xFF000000 | (x * 255 / width) << 16 | (y * 255 / height) << 8 | ((x + y) & 0xFF);  // Gradient
+            if (kind == 1) v = (unsigned int) rand() << 8 ^ rand();                                                 // Noise with alpha
+            if (kind == 2) v = ((x / 13 + y / 7) % 3 == 0) ? 0xFFFFFFFF : 0xFF2060A0;                               // Flat areas
+            if (kind == 3) v = (rand() % 16 == 0) ? 0x80FF0000 : 0xFF000000 | (y << 4);                             // Mostly flat with alpha
+            p[y * width + x] = v;
+        }
+}
+
+int main(void) {
+    static const unsigned int sizes[][2] = {{1, 1}, {3, 1}, {7, 3}, {16, 16}, {33, 65}, {100, 70}, {257, 300}, {640, 130}};
+    static const int bands[] = {1, 2, 3, 7};
+    int failures = 0;
+    srand(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        unsigned int width = sizes[s][0], height = sizes[s][1], bpp;
+        unsigned int * pixels = malloc(4 * width * height);
+        unsigned char * file = malloc(8 * width * height + 4096);
+        for (int kind = 0; kind < 4; kind++) {
+            fill(pixels, width, height, kind);
+            for (unsigned int level = 0; level <= 3; level++)
+                for (size_t b = 0; b < sizeof(bands) / sizeof(*bands); b++) {
+                    unsigned int size = encode_png((unsigned char *) pixels, width, height, level, bands[b], file, &bpp);
+                    int f = check(file, size, (unsigned char *) pixels, width, height, bpp);
+                    if (f)
+                        printf("FAIL %ux%u image %d level %u bands %d\n", width, height, kind, level, bands[b]);
+                    failures += f;
+                }
+        }
+        free(pixels);
+        free(file);
+    }
+
+    // Sizes and times of a 1920×1080 gradient with flat areas.
+    unsigned int width = 1920, height = 1080, bpp;
+    unsigned int * pixels = malloc(4 * width * height);
+    unsigned char * file = malloc(8 * width * height + 4096);
+    fill(pixels, width, height, 0);
+    for (unsigned int i = 0; i < width * height; i++)
+        if ((i / width / 100 + i % width / 100) % 2)
+            pixels[i] = 0xFF336699;
+    static const char * names[] = {"store", "fastest", "fast", "small"};
+    for (unsigned int level = 0; level <= 3; level++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        unsigned int size = encode_png((unsigned char *) pixels, width, height, level, 4, file, &bpp);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        failures += check(file, size, (unsigned char *) pixels, width, height, bpp);
+        printf("%-8s %9u bytes %8.1f ms\n", names[level], size, (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    }
+    free(pixels);
+    free(file);
+
+    printf("%s png: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
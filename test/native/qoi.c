@@ -0,0 +1,129 @@
+// Round trips and malformed input for source/qoi.c, checked against a literal reading of the QOI specification.
+// Build and run on Linux: gcc -O2 test/native/qoi.c -o qoi && ./qoi
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../source/qoi.c"
+
+// Straightforward reference encoder that works on separate r, g, b, a channels.
+static size_t reference(const unsigned int * pixels, unsigned int width, unsigned int height, unsigned char * out) {
+    unsigned char index[64][4] = {{0}}, prev[4] = {0, 0, 0, 255};
+    unsigned int n = width * height, run = 0, opaque = 1;
+    unsigned char * p = out;
+    memcpy(p, "qoif", 4);
+    store32(p + 4, width);
+    store32(p + 8, height);
+    p += 14;
+
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned char c[4] = {pixels[i] >> 16, pixels[i] >> 8, pixels[i], pixels[i] >> 24};
+        opaque &= c[3] == 255;
+        if (!memcmp(c, prev, 4)) {
+            run++;
+            if (run == 62 || i == n - 1) {
+                *p++ = 0xC0 | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *p++ = 0xC0 | (run - 1);
+            run = 0;
+        }
+        int h = (c[0] * 3 + c[1] * 5 + c[2] * 7 + c[3] * 11) % 64;
+        if (!memcmp(index[h], c, 4))
+            *p++ = h;
+        else {
+            memcpy(index[h], c, 4);
+            if (c[3] == prev[3]) {
+                int dr = (signed char) (c[0] - prev[0]), dg = (signed char) (c[1] - prev[1]), db = (signed char) (c[2] - prev[2]);
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+                    *p++ = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+                else if (dg > -33 && dg < 32 && dr - dg > -9 && dr - dg < 8 && db - dg > -9 && db - dg < 8)
+                    *p++ = 0x80 | (dg + 32), *p++ = (dr - dg + 8) << 4 | (db - dg + 8);
+                else
+                    *p++ = 0xFE, *p++ = c[0], *p++ = c[1], *p++ = c[2];
+            }
+            else
+                *p++ = 0xFF, *p++ = c[0], *p++ = c[1], *p++ = c[2], *p++ = c[3];
+        }
+        memcpy(prev, c, 4);
+    }
+    memcpy(p, "\0\0\0\0\0\0\0\1", 8);
+    out[12] = opaque ? 3 : 4;
+    out[13] = 0;
+    return p + 8 - out;
+}
+
+static void fill(unsigned int * p, unsigned int width, unsigned int height, int kind) {
+    for (unsigned int y = 0; y < height; y++)
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int v = 0;
+            if (kind == 0) v = 0xFF000000 | (x * 255 / width) << 16 | (y * 255 / height) << 8 | ((x + y) & 0xFF);  // Gradient
+            if (kind == 1) v = (unsigned int) rand() << 8 ^ rand();                                                 // Noise with alpha
+            if (kind == 2) v = ((x / 13 + y / 7) % 3 == 0) ? 0xFFFFFFFF : 0xFF000000;                               // Long runs
+            if (kind == 3) v = (rand() % 8 == 0) ? 0x80000000 | rand() % 4 << 16 : 0xFF000000 | (x / 3) << 8;       // Small differences and alpha
+            p[y * width + x] = v;
+        }
+}
+
+int main(void) {
+    static const unsigned int sizes[][2] = {{1, 1}, {3, 1}, {7, 3}, {62, 1}, {63, 2}, {100, 70}, {257, 300}};
+    int failures = 0;
+    srand(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        unsigned int width = sizes[s][0], height = sizes[s][1], stride = 4 * width + 12;
+        size_t bound = 14 + 5 * width * height + 8;
+        unsigned int * pixels = malloc(4 * width * height), * decoded = malloc(stride * height), * padded = malloc(stride * height);
+        unsigned char * expect = malloc(bound), * out = malloc(bound);
+
+        for (int kind = 0; kind < 4; kind++) {
+            fill(pixels, width, height, kind);
+            size_t size = reference(pixels, width, height, expect);
+
+            // Encode from a padded stride and compare the bytes with the reference.
+            for (unsigned int y = 0; y < height; y++)
+                memcpy((unsigned char *) padded + y * stride, pixels + y * width, 4 * width);
+            failures += qoi(0, padded, width, height, stride, out, 0) != (ptrdiff_t) size || memcmp(out, expect, size);
+
+            // Decode into a padded stride.
+            memset(decoded, 0, stride * height);
+            failures += qoi(1, decoded, width, height, stride, expect, size) != 0;
+            for (unsigned int y = 0; y < height; y++)
+                failures += memcmp((unsigned char *) decoded + y * stride, pixels + y * width, 4 * width) != 0;
+
+            // Truncated data, a wrong size, and a wrong magic number are rejected.
+            for (size_t cut = 1; cut < size; cut += 1 + cut / 4)
+                failures += qoi(1, decoded, width, height, stride, expect, size - cut) != -1;
+            failures += qoi(1, decoded, width + 1, height, stride, expect, size) != -1;
+            expect[0] = 'Q';
+            failures += qoi(1, decoded, width, height, stride, expect, size) != -1;
+        }
+        free(pixels), free(decoded), free(padded), free(expect), free(out);
+    }
+
+    // Time a 1920×1080 screenshot-like image.
+    unsigned int width = 1920, height = 1080;
+    unsigned int * pixels = malloc(4 * width * height), * decoded = malloc(4 * width * height);
+    unsigned char * out = malloc(14 + 5 * width * height + 8);
+    fill(pixels, width, height, 0);
+    for (unsigned int i = 0; i < width * height; i++)
+        if ((i / width / 100 + i % width / 100) % 2)
+            pixels[i] = 0xFF336699;
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ptrdiff_t size = qoi(0, pixels, width, height, 4 * width, out, 0);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    failures += qoi(1, decoded, width, height, 4 * width, out, size) != 0 || memcmp(decoded, pixels, 4 * width * height);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    printf("%u bytes to %td bytes, encode %.1f ms, decode %.1f ms\n", 4 * width * height, size,
+        (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6,
+        (t2.tv_sec - t1.tv_sec) * 1e3 + (t2.tv_nsec - t1.tv_nsec) / 1e6);
+
+    free(pixels), free(decoded), free(out);
+
+    printf("%s qoi: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
@@ -0,0 +1,87 @@
+// Synthetic producer and consumer for source/ring.c.
+// Build and run on Linux: gcc -O2 -pthread test/native/ring.c -o ring && ./ring
+// Every pixel of a frame holds its frame number, so a torn or recycled frame is detected.
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../source/ring.c"
+
+#define WIDTH  64
+#define HEIGHT 48
+#define FRAMES 20000
+
+static struct ring r;
+static volatile int done;
+
+static void * producer(void * arg) {
+    static unsigned int frame[WIDTH * HEIGHT];
+    for (unsigned int n = 1; n <= FRAMES; n++) {
+        int slot = ring(&r, 0, 0, 0, 0);
+        if (slot < 0)
+            continue;
+        // The next sequence number is known because only this thread publishes.
+        for (int i = 0; i < WIDTH * HEIGHT; i++)
+            frame[i] = r.written + 1;
+        ring(&r, 1, slot, (unsigned char *) frame, 4 * WIDTH);
+        if (n % 8 == 0)
+            sched_yield(); // Let the consumer keep up some of the time.
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    return arg;
+}
+
+static int run(unsigned int capacity, unsigned int policy) {
+    unsigned int stride = 4 * WIDTH + 64; // Padded like ImagePut.Stride()
+    r = (struct ring) {0};
+    r.capacity = capacity;
+    r.width = WIDTH;
+    r.height = HEIGHT;
+    r.stride = stride;
+    r.size = stride * HEIGHT;
+    r.policy = policy;
+    r.pixels = calloc(capacity, r.size);
+    r.state = calloc(capacity, sizeof(unsigned int));
+    r.sequence = calloc(capacity, sizeof(unsigned int));
+    done = 0;
+
+    pthread_t thread;
+    pthread_create(&thread, 0, producer, 0);
+
+    unsigned int frames = 0, torn = 0;
+    for (;;) {
+        int finished = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+        int slot = ring(&r, 2, 0, 0, 0);
+        if (slot < 0) {
+            if (finished)
+                break;
+            sched_yield();
+            continue;
+        }
+        unsigned int n = r.sequence[slot];
+        unsigned char * pixels = r.pixels + slot * r.size;
+        for (int y = 0; y < HEIGHT; y++)
+            for (int x = 0; x < WIDTH; x++)
+                torn += ((unsigned int *) (pixels + y * stride))[x] != n;
+        frames++;
+        ring(&r, 3, slot, 0, 0);
+    }
+    pthread_join(thread, 0);
+
+    int ok = (torn == 0) && (frames + r.dropped == FRAMES) && (r.written <= FRAMES);
+    printf("%s capacity %u, drop %s: %u read, %u dropped, %u torn pixels\n",
+        ok ? "PASS" : "FAIL", capacity, policy ? "newest" : "oldest", frames, r.dropped, torn);
+
+    free(r.pixels);
+    free((void *) r.state);
+    free(r.sequence);
+    return ok;
+}
+
+int main(void) {
+    int ok = 1;
+    for (unsigned int capacity = 2; capacity <= 4; capacity++)
+        for (unsigned int policy = 0; policy <= 1; policy++)
+            ok &= run(capacity, policy);
+    return !ok;
+}
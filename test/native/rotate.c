@@ -0,0 +1,61 @@
+// Rotating and flipping in source/rotate.c.
+// Build and run on Linux: gcc -O2 test/native/rotate.c -o rotate && ./rotate
+// All 8 orientations are checked against mapping each pixel by hand, on images with padding, in random bands of
+// rows. Flips must also work in place, and nothing may be written to the padding of the destination.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../source/rotate.c"
+#include "test.h"
+
+// Where pixel (x, y) of src goes in dst.
+static void map(unsigned int orientation, unsigned int w, unsigned int h, unsigned int x, unsigned int y, unsigned int * u, unsigned int * v) {
+    switch (orientation) {
+        case 1: *u = x, *v = y; break;
+        case 2: *u = w - 1 - x, *v = y; break;
+        case 3: *u = w - 1 - x, *v = h - 1 - y; break;
+        case 4: *u = x, *v = h - 1 - y; break;
+        case 5: *u = y, *v = x; break;
+        case 6: *u = h - 1 - y, *v = x; break;
+        case 7: *u = h - 1 - y, *v = w - 1 - x; break;
+        case 8: *u = y, *v = w - 1 - x; break;
+    }
+}
+
+int main(void) {
+    static unsigned int src[150 * 150], dst[150 * 150], expect[150 * 150];
+    int failures = 0;
+
+    for (int t = 0; t < 8000; t++) {
+        unsigned int orientation = 1 + t % 8, big = (t % 10 == 0) ? 140 : 40;
+        unsigned int width = 1 + next() % big, height = 1 + next() % big, sstride = width + next() % 6;
+        int transposed = orientation >= 5, inplace = !transposed && next() % 2;
+        unsigned int dw = transposed ? height : width, dh = transposed ? width : height;
+        unsigned int dstride = inplace ? sstride : dw + next() % 6;
+        for (unsigned int i = 0; i < sstride * height; i++)
+            src[i] = next();
+        memset(dst, 0xCD, sizeof(dst));
+
+        // The padding of an in-place image is untouched as well.
+        memcpy(expect, inplace ? src : dst, sizeof(expect));
+        for (unsigned int y = 0; y < height; y++)
+            for (unsigned int x = 0; x < width; x++) {
+                unsigned int u = x, v = y;
+                map(orientation, width, height, x, y, &u, &v);
+                expect[v * dstride + u] = src[y * sstride + x];
+            }
+
+        unsigned int * out = inplace ? src : dst;
+        struct rotate r = {.src = src, .dst = out, .width = width, .height = height,
+                           .sstride = 4 * sstride, .dstride = 4 * dstride, .orientation = orientation};
+        BANDS(rotate, &r, transposed ? dh : (orientation <= 2) ? height : (height + 1) / 2);
+
+        if (memcmp(out, expect, sizeof(expect)) != 0 && failures++ < 5)
+            printf("rotate case %d: %ux%u, orientation %u, strides %u %u%s\n", t, width, height, orientation,
+                sstride, dstride, inplace ? ", in place" : "");
+    }
+
+    printf("%s rotate: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
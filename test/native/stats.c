@@ -0,0 +1,126 @@
+// Counters reported by source/imagesearch1.c and source/imagesearch2.c, checked against a plain reference.
+// Build and run on Linux: gcc -O2 test/native/stats.c -o stats && ./stats
+// The reference visits every position in the same order and classifies it by hand, so the positions,
+// anchors, verifications, results, and the row each failed verification stopped on must agree exactly.
+// Searching with a null stats pointer must find the same match.
+// imagesearch4 counts the same as imagesearch1 until it switches to hashing, which transparent needles never do.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../source/imagesearch1.c"
+#include "../../source/imagesearch2.c"
+#include "../../source/imagesearch4.c"
+#include "test.h"
+
+static int similar(unsigned int a, unsigned int b, unsigned int v) {
+    for (int k = 0; k < 24; k += 8) {
+        int d = (int) (a >> k & 0xFF) - (int) (b >> k & 0xFF);
+        if (d > (int) v || d < -(int) v)
+            return 0;
+    }
+    return 1;
+}
+
+// Returns the first row of the needle that does not fit at this position, or h if all of it fits.
+static unsigned int mismatch(unsigned int * at, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, int exact, unsigned int v) {
+    for (unsigned int i = 0; i < h; i++)
+        for (unsigned int j = 0; j < w; j++) {
+            unsigned int c = s[i * pitch + j], p = at[i * stride + j];
+            if (c >> 24 && (exact ? c != p : !similar(c, p, v)))
+                return i;
+        }
+    return h;
+}
+
+static unsigned int * reference(unsigned int * start, unsigned int width, unsigned int height, unsigned int stride, unsigned int * s, unsigned int w, unsigned int h, unsigned int pitch, unsigned int x, unsigned int y, int exact, unsigned int v, struct imagesearch_stats * e) {
+    unsigned int cf = s[y * pitch + x], c1 = s[0];
+    memset(e, 0, sizeof(*e));
+    for (unsigned int top = 0; top + h <= height; top++)
+        for (unsigned int left = 0; left + w <= width; left++) {
+            unsigned int * at = start + top * stride + left;
+            e->positions++;
+            if (cf >> 24 && (exact ? cf != at[y * stride + x] : !similar(cf, at[y * stride + x], v)))
+                continue;
+            e->anchors++;
+            if (exact && c1 >> 24 && c1 != at[0])
+                continue;
+            e->verifications++;
+            unsigned int row = mismatch(at, stride, s, w, h, pitch, exact, v);
+            if (row == h) {
+                e->results++;
+                return at;
+            }
+            e->rejections[row < 15 ? row : 15]++;
+        }
+    return 0;
+}
+
+int main(void) {
+    static unsigned int hay[96 * 80], needle[24 * 24];
+    static const unsigned int palette[] = {0xFF000000, 0xFF102030, 0xFF112233, 0xFFFFFFFF};
+    int failures = 0;
+
+    for (int t = 0; t < 20000; t++) {
+        unsigned int width = 1 + next() % 96, height = 1 + next() % 80, stride = width + next() % 4;
+        unsigned int w = 1 + next() % 24, h = 1 + next() % 24, pitch = w + next() % 3;
+        unsigned int x = next() % w, y = next() % h, v = (t % 2) ? next() % 40 : 0;
+
+        // A small palette makes anchors pass often, so verifications fail on many different rows.
+        for (unsigned int i = 0; i < stride * height; i++)
+            hay[i] = palette[next() % 4 ? 0 : next() % 4];
+        for (unsigned int i = 0; i < pitch * h; i++)
+            needle[i] = palette[next() % 4 ? 0 : next() % 4] & (next() % 8 ? 0xFFFFFFFF : 0x00FFFFFF);
+
+        // Plant the needle in half of the cases.
+        if (t % 4 < 2 && w <= width && h <= height) {
+            unsigned int top = next() % (height - h + 1), left = next() % (width - w + 1);
+            for (unsigned int i = 0; i < h; i++)
+                for (unsigned int j = 0; j < w; j++)
+                    if (needle[i * pitch + j] >> 24)
+                        hay[(top + i) * stride + left + j] = needle[i * pitch + j];
+        }
+
+        for (int exact = 0; exact < 2; exact++) {
+            struct imagesearch_stats expect, stats;
+            memset(&stats, 0, sizeof(stats));
+            unsigned int * first = reference(hay, width, height, stride, needle, w, h, pitch, x, y, exact, exact ? 0 : v, &expect);
+            unsigned int * found = exact
+                ? imagesearch1(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, &stats)
+                : imagesearch2(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, v, &stats);
+            unsigned int * plain = exact
+                ? imagesearch1(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, 0)
+                : imagesearch2(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, v, 0);
+
+            if (found != first || plain != first || memcmp(&stats, &expect, sizeof(stats))) {
+                if (failures++ < 5)
+                    printf("imagesearch%d case %d: positions %u/%u anchors %u/%u verifications %u/%u results %u/%u\n",
+                        exact ? 1 : 2, t, stats.positions, expect.positions, stats.anchors, expect.anchors,
+                        stats.verifications, expect.verifications, stats.results, expect.results);
+            }
+
+            if (exact) {
+                unsigned int columns[96];
+                memset(&stats, 0, sizeof(stats));
+                found = imagesearch4(hay, width, height, 4 * stride, needle, w, h, 4 * pitch, x, y, columns, &stats);
+                if (found != first || stats.positions != expect.positions || stats.results != expect.results
+                || (!opaque(needle, w, h, pitch) && memcmp(&stats, &expect, sizeof(stats))))
+                    if (failures++ < 5)
+                        printf("imagesearch4 case %d: positions %u/%u anchors %u/%u verifications %u/%u results %u/%u\n",
+                            t, stats.positions, expect.positions, stats.anchors, expect.anchors,
+                            stats.verifications, expect.verifications, stats.results, expect.results);
+            }
+        }
+    }
+
+    // Counters accumulate when the same stats are passed again.
+    struct imagesearch_stats total = {0};
+    for (unsigned int i = 0; i < 64 * 64; i++)
+        hay[i] = 0xFF000000;
+    needle[0] = 0xFF000000;
+    imagesearch1(hay, 64, 64, 256, needle, 1, 1, 4, 0, 0, &total);
+    imagesearch1(hay, 64, 64, 256, needle, 1, 1, 4, 0, 0, &total);
+    failures += total.positions != 2 || total.results != 2 || total.verifications != 2;
+
+    printf("%s stats: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures != 0;
+}
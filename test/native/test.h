@@ -0,0 +1,18 @@
+// Shared by the native tests: a repeatable source of random numbers, and a way to run a kernel over its
+// rows split into bands at random, as threads would split them.
+#ifndef TEST_H
+#define TEST_H
+
+static unsigned int seed = 1;
+static unsigned int next(void) {
+    seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+    return seed;
+}
+
+// Calls kernel(r) once per band of [0, count), with the band in r->first and r->last.
+#define BANDS(kernel, r, count) \
+    for (unsigned int band_first = 0, band_last; band_first < (count); band_first = band_last) \
+        band_last = band_first + 1 + next() % ((count) - band_first), \
+        (r)->first = band_first, (r)->last = band_last, kernel(r)
+
+#endif